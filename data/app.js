@@ -1,27 +1,51 @@
 // Watch Winder Web Interface
 
 let statusInterval = null;
+let tickInterval = null;
+let eventSource = null;
+let liveStatus = null;
 let isAPMode = false;
 let wifiScanned = false;
+let motorIds = [];  // 'motor1'..'motorN', once the cards are built
 
-// Initialize on page load
-document.addEventListener('DOMContentLoaded', () => {
-    loadSettings();
+// Initialize on page load. The motor cards come from the settings, so
+// status rendering waits for them.
+document.addEventListener('DOMContentLoaded', async () => {
+    await loadSettings();
     updateStatus();
-    statusInterval = setInterval(updateStatus, 2000);
-
-    // Add change listeners to recalculate on input change
-    ['motor1', 'motor2'].forEach(motor => {
-        ['tpd', 'activeHours', 'rotationTime', 'restTime'].forEach(field => {
-            const el = document.getElementById(`${motor}-${field}`);
-            if (el) {
-                el.addEventListener('change', () => calculateSchedule(motor));
-                el.addEventListener('input', () => calculateSchedule(motor));
-            }
-        });
-    });
+    startLiveUpdates();
 });
 
+// One card per motor, cloned from the template in index.html
+function buildMotorCards(count) {
+    const container = document.getElementById('motors');
+    const template = document.getElementById('motor-template');
+    container.innerHTML = '';
+    motorIds = [];
+
+    for (let n = 1; n <= count; n++) {
+        const motorId = `motor${n}`;
+        const card = template.content.cloneNode(true);
+        card.querySelectorAll('[data-field]').forEach(el => {
+            el.id = `${motorId}-${el.dataset.field}`;
+        });
+        card.querySelector('[data-field="title"]').textContent = `Motor ${n}`;
+        card.querySelector('[data-action="start"]').addEventListener('click', () => startMotor(n));
+        card.querySelector('[data-action="stop"]').addEventListener('click', () => stopMotor(n));
+        card.querySelector('[data-action="test"]').addEventListener('click', () => testMotor(n));
+
+        // Recalculate on input change
+        ['tpd', 'windowStart', 'windowEnd', 'rotationTime', 'restTime', 'rpm'].forEach(field => {
+            const el = card.querySelector(`[data-field="${field}"]`);
+            el.addEventListener('change', () => calculateSchedule(motorId));
+            el.addEventListener('input', () => calculateSchedule(motorId));
+        });
+
+        container.appendChild(card);
+        motorIds.push(motorId);
+    }
+}
+
 // API helper
 async function api(endpoint, method = 'GET', data = null) {
     const options = {
@@ -43,35 +67,88 @@ async function api(endpoint, method = 'GET', data = null) {
     }
 }
 
-// Update status display
-async function updateStatus() {
-    try {
-        const status = await api('/status');
+// Live updates: prefer the /api/events push stream, fall back to polling
+function startLiveUpdates() {
+    if (!window.EventSource) {
+        startPolling();
+        return;
+    }
 
-        // Update connection status
-        const badge = document.getElementById('connection-status');
-        badge.textContent = 'Connected';
-        badge.className = 'status-badge connected';
+    eventSource = new EventSource('/api/events');
+
+    eventSource.addEventListener('open', () => {
+        stopPolling();
+        startLocalTick();
+    });
 
-        // Check AP mode
-        isAPMode = status.apMode;
-        document.getElementById('wifi-setup').classList.toggle('hidden', !isAPMode);
+    eventSource.addEventListener('status', event => {
+        applyStatusDelta(JSON.parse(event.data));
+    });
 
-        if (isAPMode && !wifiScanned) {
-            wifiScanned = true;
-            scanWiFi();
-        }
+    eventSource.addEventListener('error', () => {
+        // Push channel unavailable - poll until it can be re-established
+        eventSource.close();
+        eventSource = null;
+        stopLocalTick();
+        startPolling();
+        setTimeout(startLiveUpdates, 30000);
+    });
+}
+
+function startPolling() {
+    if (!statusInterval) {
+        statusInterval = setInterval(updateStatus, 2000);
+    }
+}
 
-        // Update system info
-        document.getElementById('system-ip').textContent = status.ip;
-        document.getElementById('system-uptime').textContent = formatUptime(status.uptime);
+function stopPolling() {
+    clearInterval(statusInterval);
+    statusInterval = null;
+}
+
+// While pushed, the server only sends changes, so count uptime and the
+// next-cycle countdown locally
+function startLocalTick() {
+    if (tickInterval) return;
+    tickInterval = setInterval(() => {
+        if (!liveStatus) return;
+        liveStatus.uptime++;
+        motorIds.forEach(motorId => {
+            const motor = liveStatus[motorId];
+            if (motor && motor.nextCycle > 0) motor.nextCycle--;
+        });
+        renderStatus(liveStatus);
+    }, 1000);
+}
 
-        // Update motor 1 status
-        updateMotorStatus('motor1', status.motor1);
+function stopLocalTick() {
+    clearInterval(tickInterval);
+    tickInterval = null;
+}
 
-        // Update motor 2 status
-        updateMotorStatus('motor2', status.motor2);
+// Merge a pushed status delta into the last known status
+function applyStatusDelta(delta) {
+    if (!liveStatus) {
+        liveStatus = {};
+        motorIds.forEach(motorId => liveStatus[motorId] = {});
+    }
 
+    Object.keys(delta).forEach(key => {
+        if (motorIds.includes(key)) {
+            Object.assign(liveStatus[key], delta[key]);
+        } else {
+            liveStatus[key] = delta[key];
+        }
+    });
+
+    renderStatus(liveStatus);
+}
+
+// Update status display
+async function updateStatus() {
+    try {
+        liveStatus = await api('/status');
+        renderStatus(liveStatus);
     } catch (error) {
         const badge = document.getElementById('connection-status');
         badge.textContent = 'Disconnected';
@@ -79,7 +156,34 @@ async function updateStatus() {
     }
 }
 
+function renderStatus(status) {
+    if (status.uptime === undefined) return;
+
+    // Update connection status
+    const badge = document.getElementById('connection-status');
+    badge.textContent = 'Connected';
+    badge.className = 'status-badge connected';
+
+    // Check AP mode
+    isAPMode = status.apMode;
+    document.getElementById('wifi-setup').classList.toggle('hidden', !isAPMode);
+
+    if (isAPMode && !wifiScanned) {
+        wifiScanned = true;
+        scanWiFi();
+    }
+
+    // Update system info
+    document.getElementById('system-ip').textContent = status.ip;
+    document.getElementById('system-uptime').textContent = formatUptime(status.uptime);
+
+    // Update motor status
+    motorIds.forEach(motorId => updateMotorStatus(motorId, status[motorId]));
+}
+
 function updateMotorStatus(motorId, data) {
+    if (!data || data.running === undefined) return;
+
     const statusEl = document.getElementById(`${motorId}-status`);
     statusEl.textContent = data.running ? 'Running' : 'Stopped';
     statusEl.className = `status-indicator ${data.running ? 'running' : 'stopped'}`;
@@ -97,12 +201,9 @@ async function loadSettings() {
     try {
         const settings = await api('/settings');
 
-        // Motor 1
-        populateMotorSettings('motor1', settings.motor1);
-
-        // Motor 2
-        populateMotorSettings('motor2', settings.motor2);
-
+        // Firmware from before motorCount drove two motors
+        buildMotorCards(settings.motorCount || 2);
+        motorIds.forEach(motorId => populateMotorSettings(motorId, settings[motorId]));
     } catch (error) {
         showToast('Failed to load settings', 'error');
     }
@@ -112,14 +213,16 @@ function populateMotorSettings(motorId, data) {
     document.getElementById(`${motorId}-enabled`).checked = data.enabled;
     document.getElementById(`${motorId}-direction`).value = data.direction;
     document.getElementById(`${motorId}-tpd`).value = data.tpd;
-    document.getElementById(`${motorId}-activeHours`).value = data.activeHours;
+    document.getElementById(`${motorId}-windowStart`).value = minutesToTime(data.windowStart);
+    document.getElementById(`${motorId}-windowEnd`).value = minutesToTime(data.windowEnd);
     document.getElementById(`${motorId}-rotationTime`).value = data.rotationTime;
     document.getElementById(`${motorId}-restTime`).value = data.restTime;
+    document.getElementById(`${motorId}-rpm`).value = data.rpm;
+    document.getElementById(`${motorId}-driveMode`).value = data.driveMode || 0;
 
     // Update calculated values
-    document.getElementById(`${motorId}-cycles-calc`).textContent = data.cyclesPerDay;
-    document.getElementById(`${motorId}-turns-calc`).textContent =
-        data.turnsPerCycle.toFixed(2);
+    showSchedule(motorId, data.cyclesPerDay, data.turnsPerCycle, data.burstMs,
+                 data.tpdReachable !== false);
 }
 
 function getMotorSettings(motorId) {
@@ -127,38 +230,70 @@ function getMotorSettings(motorId) {
         enabled: document.getElementById(`${motorId}-enabled`).checked,
         direction: parseInt(document.getElementById(`${motorId}-direction`).value),
         tpd: parseInt(document.getElementById(`${motorId}-tpd`).value),
-        activeHours: parseInt(document.getElementById(`${motorId}-activeHours`).value),
+        windowStart: timeToMinutes(document.getElementById(`${motorId}-windowStart`).value),
+        windowEnd: timeToMinutes(document.getElementById(`${motorId}-windowEnd`).value),
         rotationTime: parseInt(document.getElementById(`${motorId}-rotationTime`).value),
-        restTime: parseInt(document.getElementById(`${motorId}-restTime`).value)
+        restTime: parseInt(document.getElementById(`${motorId}-restTime`).value),
+        rpm: parseInt(document.getElementById(`${motorId}-rpm`).value),
+        driveMode: parseInt(document.getElementById(`${motorId}-driveMode`).value)
     };
 }
 
+// Same sums as Scheduler::calculateSchedule() in the firmware
 function calculateSchedule(motorId) {
     const settings = getMotorSettings(motorId);
+    const slotMs = settings.rotationTime * 1000;
+    const restMs = settings.restTime * 60 * 1000;
+
+    // Active window (equal = all day)
+    let activeMinutes = settings.windowEnd - settings.windowStart;
+    if (activeMinutes <= 0) activeMinutes += 24 * 60;
+    const activeMs = activeMinutes * 60 * 1000;
+
+    // Time the whole day's turns take at speed
+    const turningMs = Math.floor(settings.tpd * 60000 / settings.rpm);
+    const tpdReachable = turningMs <= activeMs;
+
+    // Bursts longer than the slot stretch it, leaving the turning time plus
+    // as many rests as still fit
+    let cyclesPerDay = Math.floor(activeMs / (slotMs + restMs));
+    if (cyclesPerDay > 0 && Math.floor(turningMs / cyclesPerDay) > slotMs) {
+        cyclesPerDay = tpdReachable && restMs > 0
+            ? Math.floor((activeMs - turningMs) / restMs) : 1;
+    }
+    cyclesPerDay = Math.max(1, cyclesPerDay);
 
-    // Calculate cycle duration in milliseconds
-    const cycleDurationMs = (settings.rotationTime * 1000) +
-                            (settings.restTime * 60 * 1000);
-
-    // Calculate cycles per day
-    const activeMs = settings.activeHours * 60 * 60 * 1000;
-    const cyclesPerDay = Math.floor(activeMs / cycleDurationMs);
-
-    // Calculate turns per cycle
     const turnsPerCycle = settings.tpd / cyclesPerDay;
+    const burstMs = Math.ceil(settings.tpd * 60000 / (settings.rpm * cyclesPerDay));
+
+    showSchedule(motorId, cyclesPerDay, turnsPerCycle, burstMs, tpdReachable);
+}
 
+function showSchedule(motorId, cyclesPerDay, turnsPerCycle, burstMs, tpdReachable) {
     document.getElementById(`${motorId}-cycles-calc`).textContent = cyclesPerDay;
     document.getElementById(`${motorId}-turns-calc`).textContent =
         turnsPerCycle.toFixed(2);
+    document.getElementById(`${motorId}-burst-calc`).textContent =
+        burstMs ? (burstMs / 1000).toFixed(1) : '--';
+    document.getElementById(`${motorId}-tpd-warning`).hidden = tpdReachable;
+}
+
+// Active windows are sent as minutes after midnight
+function timeToMinutes(value) {
+    const [hours, minutes] = value.split(':').map(Number);
+    return hours * 60 + minutes;
+}
+
+function minutesToTime(minutes) {
+    const pad = n => String(n).padStart(2, '0');
+    return `${pad(Math.floor(minutes / 60))}:${pad(minutes % 60)}`;
 }
 
 // Save settings to device
 async function saveSettings() {
     try {
-        const data = {
-            motor1: getMotorSettings('motor1'),
-            motor2: getMotorSettings('motor2')
-        };
+        const data = {};
+        motorIds.forEach(motorId => data[motorId] = getMotorSettings(motorId));
 
         await api('/settings', 'POST', data);
         showToast('Settings saved', 'success');
@@ -188,7 +323,7 @@ async function stopAll() {
 
 async function startMotor(motor) {
     try {
-        await api('/start', 'POST', { motor });
+        await api(`/motors/${motor}/start`, 'POST');
         showToast(`Motor ${motor} started`, 'success');
     } catch (error) {
         showToast(`Failed to start motor ${motor}`, 'error');
@@ -197,7 +332,7 @@ async function startMotor(motor) {
 
 async function stopMotor(motor) {
     try {
-        await api('/stop', 'POST', { motor });
+        await api(`/motors/${motor}/stop`, 'POST');
         showToast(`Motor ${motor} stopped`, 'success');
     } catch (error) {
         showToast(`Failed to stop motor ${motor}`, 'error');
@@ -208,7 +343,7 @@ async function testMotor(motor) {
     const direction = parseInt(document.getElementById(`motor${motor}-direction`).value);
     try {
         showToast(`Testing motor ${motor}...`, 'success');
-        await api('/test', 'POST', { motor, direction, duration: 3 });
+        await api(`/motors/${motor}/test`, 'POST', { direction, duration: 3 });
     } catch (error) {
         showToast(`Failed to test motor ${motor}`, 'error');
     }
@@ -218,10 +353,19 @@ async function testMotor(motor) {
 async function scanWiFi() {
     try {
         const select = document.getElementById('wifi-ssid');
-        select.innerHTML = '<option value="">Scanning...</option>';
-
         const data = await api('/wifi/scan');
 
+        // The device scans in the background - show what is cached and
+        // ask again once the refresh is done
+        if (data.scanning) {
+            setTimeout(scanWiFi, 1500);
+            if (data.networks.length === 0) {
+                select.innerHTML = '<option value="">Scanning...</option>';
+                return;
+            }
+        }
+
+        const selected = select.value;
         select.innerHTML = '<option value="">Select network...</option>';
         data.networks.forEach(network => {
             const option = document.createElement('option');
@@ -229,6 +373,7 @@ async function scanWiFi() {
             option.textContent = `${network.ssid} (${network.rssi} dBm)${network.secure ? ' *' : ''}`;
             select.appendChild(option);
         });
+        select.value = selected;
     } catch (error) {
         showToast('Failed to scan WiFi networks', 'error');
     }
@@ -245,7 +390,7 @@ async function connectWiFi() {
 
     try {
         await api('/wifi/connect', 'POST', { ssid, password });
-        showToast('Connecting... Device will reboot', 'success');
+        showToast('Joining network... the setup network closes once connected', 'success');
     } catch (error) {
         showToast('Failed to save WiFi credentials', 'error');
     }
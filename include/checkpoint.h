@@ -0,0 +1,168 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "config.h"
+#include "crc32.h"
+#include "scheduler.h"
+
+struct CheckpointRecord {
+    uint32_t magic;
+    uint32_t sequence;
+    SchedulerCheckpoint motors[MOTOR_COUNT];
+    uint32_t crc;               // Over everything above
+};
+
+static_assert(sizeof(CheckpointRecord) % 4 == 0, "RTC memory is written in 4-byte blocks");
+static_assert(CHECKPOINT_RTC_OFFSET * 4 + sizeof(CheckpointRecord) <= 512,
+              "Checkpoint doesn't fit in RTC user memory");
+
+const uint32_t CHECKPOINT_MAGIC = 0x57574350;  // "WWCP"
+
+// Scheduler progress checkpoints.
+// RTC user memory survives watchdog resets, crashes and OTA restarts, and
+// is cheap enough to write every CHECKPOINT_INTERVAL_MS. It is lost on power
+// loss, so a copy also goes to flash every CHECKPOINT_FLASH_INTERVAL_MS and
+// whenever a scheduler is started or stopped.
+class CheckpointStore {
+private:
+    uint32_t sequence;
+    unsigned long lastRtcWrite;
+    unsigned long lastFlashWrite;
+    uint8_t flashRunning[MOTOR_COUNT];  // Run state in the last flash copy
+    uint32_t flashWrites;
+
+public:
+    CheckpointStore() {
+        sequence = 0;
+        lastRtcWrite = 0;
+        lastFlashWrite = 0;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            flashRunning[m] = 0;
+        }
+        flashWrites = 0;
+    }
+
+    // Find the newest valid checkpoint, RTC memory first
+    bool load(CheckpointRecord& record) {
+        CheckpointRecord rtc;
+        CheckpointRecord flash;
+        bool rtcValid = readRtc(rtc);
+        bool flashValid = readFlash(flash);
+
+        if (rtcValid && (!flashValid || (int32_t)(rtc.sequence - flash.sequence) >= 0)) {
+            record = rtc;
+            Serial.println("Checkpoint restored from RTC memory");
+        } else if (flashValid) {
+            record = flash;
+            Serial.println("Checkpoint restored from flash");
+        } else {
+            return false;
+        }
+
+        sequence = record.sequence;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            flashRunning[m] = record.motors[m].running;
+        }
+        return true;
+    }
+
+    // Call from loop() with the current progress
+    void update(const SchedulerCheckpoint* motors) {
+        unsigned long now = millis();
+        bool runStateChanged = false;
+        bool anyRunning = false;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            runStateChanged |= motors[m].running != flashRunning[m];
+            anyRunning |= motors[m].running != 0;
+        }
+        bool flashDue = now - lastFlashWrite >= CHECKPOINT_FLASH_INTERVAL_MS;
+        bool rtcDue = now - lastRtcWrite >= CHECKPOINT_INTERVAL_MS;
+
+        if (!rtcDue && !runStateChanged) {
+            return;
+        }
+
+        CheckpointRecord record;
+        record.magic = CHECKPOINT_MAGIC;
+        record.sequence = ++sequence;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            record.motors[m] = motors[m];
+        }
+        record.crc = crc32Update(&record, offsetof(CheckpointRecord, crc));
+
+        writeRtc(record);
+        lastRtcWrite = now;
+
+        // Nothing worth keeping across a power cut while all are stopped
+        if (runStateChanged || (flashDue && anyRunning)) {
+            writeFlash(record);
+            lastFlashWrite = now;
+            for (int m = 0; m < MOTOR_COUNT; m++) {
+                flashRunning[m] = motors[m].running;
+            }
+        }
+    }
+
+    // Milliseconds until the next RTC checkpoint
+    unsigned long msUntilDue() {
+        unsigned long elapsed = millis() - lastRtcWrite;
+        return elapsed >= CHECKPOINT_INTERVAL_MS ? 0 : CHECKPOINT_INTERVAL_MS - elapsed;
+    }
+
+    uint32_t getFlashWrites() {
+        return flashWrites;
+    }
+
+private:
+    static bool isValid(const CheckpointRecord& record) {
+        return record.magic == CHECKPOINT_MAGIC &&
+               record.crc == crc32Update(&record, offsetof(CheckpointRecord, crc));
+    }
+
+#ifdef ARDUINO_ARCH_ESP8266
+    bool readRtc(CheckpointRecord& record) {
+        return ESP.rtcUserMemoryRead(CHECKPOINT_RTC_OFFSET, (uint32_t*)&record, sizeof(record)) &&
+               isValid(record);
+    }
+
+    void writeRtc(CheckpointRecord& record) {
+        ESP.rtcUserMemoryWrite(CHECKPOINT_RTC_OFFSET, (uint32_t*)&record, sizeof(record));
+    }
+#else
+    // No RTC memory - flash only
+    bool readRtc(CheckpointRecord&) {
+        return false;
+    }
+
+    void writeRtc(CheckpointRecord&) {
+    }
+#endif
+
+    bool readFlash(CheckpointRecord& record) {
+        File file = LittleFS.open(CHECKPOINT_FILE, "r");
+        if (!file) {
+            return false;
+        }
+        bool ok = file.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+        file.close();
+        return ok && isValid(record);
+    }
+
+    // Written to a temporary file and renamed over the old copy, so a power
+    // cut mid-write leaves the previous checkpoint in place
+    void writeFlash(const CheckpointRecord& record) {
+        File file = LittleFS.open(CHECKPOINT_FILE ".tmp", "w");
+        if (!file) {
+            return;
+        }
+        bool ok = file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+        file.close();
+        if (ok && LittleFS.rename(CHECKPOINT_FILE ".tmp", CHECKPOINT_FILE)) {
+            flashWrites++;
+        }
+    }
+};
+
+#endif // CHECKPOINT_H
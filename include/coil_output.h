@@ -0,0 +1,130 @@
+#ifndef COIL_OUTPUT_H
+#define COIL_OUTPUT_H
+
+#include <Arduino.h>
+#include "config.h"
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER && defined(ARDUINO_ARCH_ESP8266)
+#include <SPI.h>
+#endif
+
+// Coil outputs that change during one step engine tick, as bitmasks. Bit n
+// is GPIOn for GpioCoilOutput and shift register output n for
+// ShiftRegisterCoilOutput; motors only see them through pinMask().
+struct CoilFrame {
+    uint32_t set;
+    uint32_t clear;
+};
+
+// Register-level coil output: every motor's phase change for a tick goes
+// out as one GPOS (set) and one GPOC (clear) write, instead of four
+// digitalWrite() calls per motor. Coil pins must be GPIO0-15 (not D0/GPIO16).
+class GpioCoilOutput {
+public:
+    static constexpr uint32_t pinMask(int pin) {
+        return 1UL << pin;
+    }
+
+    // Make the pins in the mask outputs and switch them off
+    static void begin(uint32_t mask) {
+        for (int pin = 0; pin < 16; pin++) {
+            if (mask & pinMask(pin)) {
+                pinMode(pin, OUTPUT);
+            }
+        }
+        write({0, mask});
+    }
+
+    static void IRAM_ATTR write(const CoilFrame& frame) {
+        // Energize new coils before releasing old ones so the rotor is never unheld
+#ifdef ARDUINO_ARCH_ESP8266
+        if (frame.set) GPOS = frame.set;
+        if (frame.clear) GPOC = frame.clear;
+#else
+        // Portable fallback for non-ESP8266 builds: one write per changed pin
+        for (int pin = 0; pin < 16; pin++) {
+            if (frame.set & pinMask(pin)) digitalWrite(pin, HIGH);
+        }
+        for (int pin = 0; pin < 16; pin++) {
+            if (frame.clear & pinMask(pin)) digitalWrite(pin, LOW);
+        }
+#endif
+    }
+};
+
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER
+static_assert(SHIFT_REGISTER_CHIPS <= 4, "The chain image is one 32-bit SPI word");
+
+// 74HC595 daisy-chain coil output. The image of every chain output is kept
+// here; a tick that changes any coil shifts the whole chain out in one
+// hardware SPI transfer and latches it, so all motors change phase on the
+// same RCLK edge. The transfer is started from registers rather than the
+// SPI library, which isn't in IRAM.
+class ShiftRegisterCoilOutput {
+private:
+    static inline uint32_t outputs = 0;
+    static inline bool started = false;
+
+public:
+    static constexpr uint32_t pinMask(int output) {
+        return 1UL << output;
+    }
+
+    // The bus is shared - the first motor sets it up, each motor then
+    // releases its own outputs
+    static void begin(uint32_t mask) {
+        if (!started) {
+            started = true;
+            pinMode(SHIFT_REGISTER_LATCH, OUTPUT);
+            digitalWrite(SHIFT_REGISTER_LATCH, LOW);
+#ifdef ARDUINO_ARCH_ESP8266
+            SPI.begin();
+            SPI.setFrequency(SHIFT_REGISTER_SPI_HZ);
+            SPI.setDataMode(SPI_MODE0);
+            SPI.setBitOrder(MSBFIRST);
+
+            // Fix the transfer length to the chain, so write() only has to
+            // load the word and start it
+            const uint32_t bits = SHIFT_REGISTER_CHIPS * 8 - 1;
+            SPI1U1 = (SPI1U1 & ~((SPIMMOSI << SPILMOSI) | (SPIMMISO << SPILMISO))) |
+                     (bits << SPILMOSI) | (bits << SPILMISO);
+#else
+            pinMode(SHIFT_REGISTER_DATA, OUTPUT);
+            pinMode(SHIFT_REGISTER_CLOCK, OUTPUT);
+#endif
+        }
+        write({0, mask});
+    }
+
+    static void IRAM_ATTR write(const CoilFrame& frame) {
+        if ((frame.set | frame.clear) == 0) {
+            return;
+        }
+        // Both halves land on the same latch edge, so there is no ordering
+        // to get right here
+        outputs = (outputs & ~frame.clear) | frame.set;
+
+        // The chip furthest down the chain has to go out first
+        uint32_t word = __builtin_bswap32(outputs) >> (32 - SHIFT_REGISTER_CHIPS * 8);
+#ifdef ARDUINO_ARCH_ESP8266
+        SPI1W0 = word;
+        SPI1CMD |= SPIBUSY;
+        while (SPI1CMD & SPIBUSY) {}
+        GPOS = pinMask(SHIFT_REGISTER_LATCH);
+        GPOC = pinMask(SHIFT_REGISTER_LATCH);
+#else
+        // Portable fallback: bit-bang the same word
+        for (int i = 0; i < SHIFT_REGISTER_CHIPS; i++) {
+            shiftOut(SHIFT_REGISTER_DATA, SHIFT_REGISTER_CLOCK, MSBFIRST, (word >> (8 * i)) & 0xFF);
+        }
+        digitalWrite(SHIFT_REGISTER_LATCH, HIGH);
+        digitalWrite(SHIFT_REGISTER_LATCH, LOW);
+#endif
+    }
+};
+
+typedef ShiftRegisterCoilOutput CoilOutput;
+#else
+typedef GpioCoilOutput CoilOutput;
+#endif
+
+#endif // COIL_OUTPUT_H
@@ -0,0 +1,79 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+
+// Commands posted by the async web handlers and applied by loop()
+enum CommandType {
+    CMD_START,
+    CMD_STOP,
+    CMD_TEST,
+    CMD_SETTINGS,
+    CMD_WIFI_CONNECT,
+    CMD_TRACE
+};
+
+struct Command {
+    CommandType type;
+    int motor;                  // 0 = all, otherwise motor number
+    int direction;              // CMD_TEST
+    int duration;               // CMD_TEST, seconds
+    uint32_t receivedUs;        // When the handler queued it, for latency metrics
+    int traceEvents;            // CMD_TRACE, 0 = off
+    MotorSettings settings;     // CMD_SETTINGS
+    char ssid[33];              // CMD_WIFI_CONNECT
+    char password[65];
+};
+
+// Lock-free single-producer/single-consumer ring buffer.
+// The producer only writes head and the consumer only writes tail, so no
+// locking is needed as long as each side stays in its own context.
+template <typename T, unsigned int N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "Queue size must be a power of two");
+
+private:
+    T items[N];
+    volatile unsigned int head;
+    volatile unsigned int tail;
+
+public:
+    SpscQueue() {
+        head = 0;
+        tail = 0;
+    }
+
+    // Producer side. Returns false if the queue is full.
+    bool push(const T& item) {
+        unsigned int h = head;
+        if (h - tail >= N) {
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        __sync_synchronize();  // Item must be visible before head moves
+        head = h + 1;
+        return true;
+    }
+
+    // Producer side. Only grows until the producer pushes again, since the
+    // consumer can only free slots.
+    unsigned int freeSlots() {
+        return N - (head - tail);
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T& item) {
+        unsigned int t = tail;
+        if (t == head) {
+            return false;
+        }
+        item = items[t & (N - 1)];
+        __sync_synchronize();  // Finish reading before the slot is released
+        tail = t + 1;
+        return true;
+    }
+};
+
+#endif // COMMAND_QUEUE_H
@@ -14,7 +14,41 @@
 #define AP_PASSWORD ""  // Empty = open network
 
 // WiFi connection timeout (milliseconds)
-#define WIFI_TIMEOUT 15000
+#define WIFI_TIMEOUT 15000           // Per connection attempt (ms)
+#define WIFI_MAX_FAILURES 3          // Failed attempts before the setup AP comes up
+#define WIFI_BACKOFF_MIN_MS 2000     // First retry delay, doubled per failure
+#define WIFI_BACKOFF_MAX_MS 300000   // Longest retry delay
+
+// Background network scan for the setup page
+#define WIFI_SCAN_MAX_RESULTS 10     // Strongest networks kept
+#define WIFI_SCAN_MAX_AGE_MS 30000   // Cached results older than this are refreshed
+
+// ============================================
+// Coil Output
+// ============================================
+// COIL_OUTPUT_GPIO: two motors wired straight to D1-D8 (below)
+// COIL_OUTPUT_SHIFT_REGISTER: up to eight motors on a daisy chain of
+// 74HC595s feeding the ULN2003 boards, two motors per chip
+#define COIL_OUTPUT_GPIO 0
+#define COIL_OUTPUT_SHIFT_REGISTER 1
+#ifndef COIL_OUTPUT
+#define COIL_OUTPUT COIL_OUTPUT_GPIO
+#endif
+
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER
+#define MOTOR_COUNT 8
+#else
+#define MOTOR_COUNT 2
+#endif
+
+// 74HC595 chain, clocked by the hardware SPI block. Motor n drives outputs
+// QA-QD (odd n) or QE-QH (even n) of chip (n + 1) / 2, counting from the
+// chip nearest the ESP8266. Tie /OE low and /SRCLR high.
+#define SHIFT_REGISTER_DATA D7       // GPIO13 (HSPI MOSI) - SER
+#define SHIFT_REGISTER_CLOCK D5      // GPIO14 (HSPI SCK) - SRCLK
+#define SHIFT_REGISTER_LATCH D8      // GPIO15 - RCLK
+#define SHIFT_REGISTER_CHIPS ((MOTOR_COUNT + 1) / 2)
+#define SHIFT_REGISTER_SPI_HZ 8000000
 
 // ============================================
 // Motor 1 Pin Definitions (ULN2003 #1)
@@ -46,16 +80,70 @@
 // ============================================
 #define STEPS_PER_REVOLUTION 2038  // Full steps (gear ratio 63.68395:1)
 #define HALF_STEPS_PER_REVOLUTION 4076  // Half steps per revolution
-#define STEP_DELAY_MS 2            // Delay between steps (~7 RPM, max safe ~15 RPM)
+#define MIN_RPM 1                  // Output shaft speed limits
+#define MAX_RPM 15                 // Max safe speed for the 28BYJ-48
+
+// Acceleration ramp (see ramp_profile.h)
+#define RAMP_STEPS 128             // Max half-steps spent accelerating
+#define RAMP_START_US 3000         // First half-step interval (~5 RPM)
+#define RAMP_ACCEL 4000            // Half-steps per second^2
+
+// ============================================
+// Step Engine (timer1 interrupt)
+// ============================================
+#define STEP_TICK_US 100           // Step engine tick period (microseconds)
+#ifndef STEP_ENGINE_MAX_MOTORS
+#define STEP_ENGINE_MAX_MOTORS 8   // Motors that can be attached to the engine
+#endif
+
+// Hold current chopping. At low speed most of each step interval is spent
+// holding the phase; once HOLD_DWELL_US has passed after a step, the coils
+// are only on for HOLD_CHOP_ON of every HOLD_CHOP_PERIOD ticks until the
+// next one. Only when cruising at HOLD_CHOP_MIN_INTERVAL_US per step or
+// slower, so normal speeds and the ramps keep full torque. A dwell of 0
+// keeps the coils fully on.
+#define HOLD_DWELL_US 1200         // Full current after each step
+#define HOLD_CHOP_MIN_INTERVAL_US 8000  // 1 RPM half-step, 1-3 RPM full/wave
+#define HOLD_CHOP_PERIOD 4         // Ticks per chop period
+#define HOLD_CHOP_ON 1             // Ticks on per period (25% duty)
 
 // ============================================
 // Default Motor Settings
 // ============================================
 #define DEFAULT_TPD 650              // Turns per day
 #define DEFAULT_ACTIVE_HOURS 12      // Hours of operation per day
-#define DEFAULT_ROTATION_TIME 10     // Seconds per rotation burst
+#define DEFAULT_WINDOW_START 480     // Active window start, minutes after midnight (08:00)
+#define DEFAULT_WINDOW_END (DEFAULT_WINDOW_START + DEFAULT_ACTIVE_HOURS * 60)
+#define DEFAULT_ROTATION_TIME 10     // Shortest slot for a rotation burst (seconds)
 #define DEFAULT_REST_TIME 5          // Minutes between rotations
 #define DEFAULT_DIRECTION 0          // 0=CW, 1=CCW, 2=Bidirectional
+#define DEFAULT_RPM 7                // Rotation speed during bursts (RPM)
+
+// ============================================
+// Power
+// ============================================
+// Shared 5V motor supply. Bursts are queued so the motors energized at
+// once never draw more than the budget; leave headroom below the rating.
+#define MOTOR_CURRENT_MA 240         // One energized 28BYJ-48 with its ULN2003
+#define MOTOR_BUDGET_MA 1500         // 5V 2A supply
+
+// 0 = busy loop, 1 = delay, 2 = modem sleep, 3 = light sleep when motors are idle
+#define IDLE_MODE 3
+#define IDLE_MAX_DELAY_MS 100        // Longest single idle period
+
+// Typical ESP8266 supply current per state, for the metrics estimate
+#define CURRENT_ACTIVE_MA 80.0f
+#define CURRENT_IDLE_MA 70.0f
+#define CURRENT_MODEM_SLEEP_MA 18.0f
+#define CURRENT_LIGHT_SLEEP_MA 3.0f
+
+// ============================================
+// Time
+// ============================================
+#define NTP_SERVER "pool.ntp.org"
+#define TIMEZONE "UTC0"              // POSIX TZ string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3"
+#define MIN_VALID_EPOCH 1700000000   // Earlier clock readings mean SNTP hasn't synced yet
+#define SCHED_MAX_SLEEP_MS 60000     // Longest a sleeping scheduler goes without checking the clock
 
 // ============================================
 // Web Server
@@ -63,9 +151,41 @@
 #define WEB_SERVER_PORT 80
 #define DNS_PORT 53
 
+// Live status push (Server-Sent Events on /api/events)
+#define SSE_MAX_CLIENTS 4            // Concurrent subscribers
+#define SSE_PUSH_INTERVAL_MS 250     // How often status is checked for changes
+
+// Async web server
+#define COMMAND_QUEUE_SIZE 16        // Pending web commands (power of two), room for
+                                     // a settings update of every motor
+#define MAX_REQUEST_BODY 2048        // Largest accepted POST body (bytes)
+#define JSON_RESPONSE_SLOTS 2        // JSON bodies being sent at once without a heap copy
+
+// Step timing trace (/api/diag/steptrace), 4 bytes per event
+#define STEP_TRACE_EVENTS 512        // Default buffer per traced motor
+#define STEP_TRACE_MAX_EVENTS 2048
+
 // ============================================
 // Storage
 // ============================================
-#define SETTINGS_FILE "/settings.json"
+#define SETTINGS_FILE "/settings.json"    // Legacy format, migrated on boot
+#define SETTINGS_SLOT_A "/settings.a"
+#define SETTINGS_SLOT_B "/settings.b"
+#define SETTINGS_WRITE_DELAY_MS 3000      // Quiet time before changes are written
+#define SETTINGS_MAX_DELAY_MS 30000       // Longest a change waits for flash
+
+// Scheduler progress checkpoints
+#define CHECKPOINT_FILE "/checkpoint.bin"
+#define CHECKPOINT_RTC_OFFSET 32          // RTC user memory block; the first 32 are used by OTA
+#define CHECKPOINT_INTERVAL_MS 1000       // RTC memory
+#define CHECKPOINT_FLASH_INTERVAL_MS 900000  // Flash fallback (15 minutes)
+
+// Winding history (/api/history), 16 bytes per cycle or day
+#define HISTORY_FILE "/history.bin"
+#define HISTORY_DAYS_FILE "/history_days.bin"
+#define HISTORY_PAGE_RECORDS 16           // Cycles per flash write
+#define HISTORY_PAGES 256                 // Ring of 4096 cycles (~70 KB)
+#define HISTORY_DAYS 90                   // Daily totals kept per motor
+#define HISTORY_FLUSH_MS 900000           // Longest a partial page waits for flash (15 minutes)
 
 #endif // CONFIG_H
@@ -0,0 +1,132 @@
+#ifndef DEADLINE_QUEUE_H
+#define DEADLINE_QUEUE_H
+
+#include <Arduino.h>
+#include <limits.h>
+
+// Min-heap of millis() deadlines for up to N ids (0..N-1).
+// Each id has at most one deadline; scheduling it again moves it. Deadlines
+// are compared by signed difference, so ordering holds across the millis()
+// wrap as long as they are within ~24 days of each other.
+template <unsigned int N>
+class DeadlineQueue {
+private:
+    struct Entry {
+        uint32_t deadline;          // millis() times are 32-bit on every target
+        uint8_t id;
+    };
+
+    Entry heap[N];
+    int8_t position[N];         // Heap index of each id, -1 if not queued
+    unsigned int count;
+
+public:
+    DeadlineQueue() {
+        count = 0;
+        for (unsigned int i = 0; i < N; i++) {
+            position[i] = -1;
+        }
+    }
+
+    // Add or move the deadline for an id
+    void schedule(unsigned int id, uint32_t deadline) {
+        int i = position[id];
+        if (i < 0) {
+            i = count++;
+            heap[i].id = id;
+        }
+        heap[i].deadline = deadline;
+        place(i);
+        siftUp(position[id]);
+        siftDown(position[id]);
+    }
+
+    void cancel(unsigned int id) {
+        int i = position[id];
+        if (i < 0) {
+            return;
+        }
+        position[id] = -1;
+        count--;
+        if ((unsigned int)i < count) {
+            // Fill the hole with the last entry and restore heap order
+            heap[i] = heap[count];
+            place(i);
+            unsigned int moved = heap[i].id;
+            siftUp(i);
+            siftDown(position[moved]);
+        }
+    }
+
+    // Remove and return an id whose deadline has passed
+    bool popDue(uint32_t now, unsigned int& id) {
+        if (count == 0 || before(now, heap[0].deadline)) {
+            return false;
+        }
+        id = heap[0].id;
+        cancel(id);
+        return true;
+    }
+
+    // Milliseconds until the earliest deadline, ULONG_MAX if none
+    unsigned long msUntilNext(uint32_t now) {
+        if (count == 0) {
+            return ULONG_MAX;
+        }
+        int32_t remaining = (int32_t)(heap[0].deadline - now);
+        return remaining > 0 ? remaining : 0;
+    }
+
+    unsigned int size() {
+        return count;
+    }
+
+private:
+    static bool before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+    }
+
+    void place(int i) {
+        position[heap[i].id] = i;
+    }
+
+    void swap(int a, int b) {
+        Entry t = heap[a];
+        heap[a] = heap[b];
+        heap[b] = t;
+        place(a);
+        place(b);
+    }
+
+    void siftUp(int i) {
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!before(heap[i].deadline, heap[parent].deadline)) {
+                break;
+            }
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(int i) {
+        for (;;) {
+            int smallest = i;
+            int left = 2 * i + 1;
+            int right = left + 1;
+            if (left < (int)count && before(heap[left].deadline, heap[smallest].deadline)) {
+                smallest = left;
+            }
+            if (right < (int)count && before(heap[right].deadline, heap[smallest].deadline)) {
+                smallest = right;
+            }
+            if (smallest == i) {
+                break;
+            }
+            swap(i, smallest);
+            i = smallest;
+        }
+    }
+};
+
+#endif // DEADLINE_QUEUE_H
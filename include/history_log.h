@@ -0,0 +1,396 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <limits.h>
+#include <time.h>
+#include "config.h"
+#include "crc32.h"
+#include "wall_clock.h"
+
+enum CycleFlags {
+    CYCLE_INTERRUPTED = 1           // Cut short by a reset, counted with the steps it got
+};
+
+// One completed cycle. Fixed-width, since it is stored raw on flash.
+struct CycleRecord {
+    uint32_t time;          // Unix time the burst ended, 0 before SNTP sync
+    int32_t day;            // Wall-clock day the cycle counts towards, or NO_DAY
+    uint32_t halfSteps;
+    uint16_t cycle;         // Cycle of the day, from 1
+    uint8_t motor;          // Motor number, from 1
+    uint8_t flags;          // CycleFlags
+};
+
+// Totals of one motor for one day
+struct DayRecord {
+    int32_t day;
+    uint32_t halfSteps;
+    uint16_t cycles;
+    uint16_t target;        // Cycles the schedule planned for the day
+    uint8_t motor;          // Motor number, 0 for an unused slot
+    uint8_t reserved[3];
+};
+
+struct HistoryPageHeader {
+    uint32_t magic;
+    uint32_t sequence;      // Higher is newer
+    uint16_t count;         // Records in use
+    uint16_t reserved;
+    uint32_t crc;           // Over the fields above plus the records in use
+};
+
+struct HistoryPage {
+    HistoryPageHeader header;
+    CycleRecord records[HISTORY_PAGE_RECORDS];
+};
+
+static_assert(sizeof(CycleRecord) == 16 && sizeof(DayRecord) == 16, "Records are a file format");
+
+const uint32_t HISTORY_MAGIC = 0x57574831;  // "WWH1"
+
+// Winding history.
+// Completed cycles are appended to a page in RAM, which goes to flash as a
+// whole once it fills up, or after HISTORY_FLUSH_MS so a power cut loses
+// little. A record arriving at a full page writes it out first, so nothing
+// is lost to a late flush(). The log file is a ring of HISTORY_PAGES pages that overwrites the
+// oldest. Daily totals live in a second file with a fixed slot per day and
+// motor, so reading them never has to walk the cycles.
+class HistoryLog {
+private:
+    HistoryPage page;           // Page being filled
+    int slot;                   // Where it goes in the ring
+    unsigned long pageSince;    // When its first unflushed record arrived
+    bool pageDirty;
+
+    DayRecord openDays[MOTOR_COUNT];    // Day being counted for each motor
+    DayRecord closedDays[MOTOR_COUNT];  // Previous day, waiting for flash
+    bool openDirty[MOTOR_COUNT];
+    bool closedPending[MOTOR_COUNT];
+    long latestDay;
+
+    // Metrics
+    uint32_t appended;
+    uint32_t flushes;
+    uint32_t dropped;           // Records lost to a full page that couldn't be written
+
+public:
+    HistoryLog() {
+        memset(&page, 0, sizeof(page));
+        slot = 0;
+        pageSince = 0;
+        pageDirty = false;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            memset(&openDays[m], 0, sizeof(DayRecord));
+            memset(&closedDays[m], 0, sizeof(DayRecord));
+            openDirty[m] = false;
+            closedPending[m] = false;
+        }
+        latestDay = NO_DAY;
+        appended = 0;
+        flushes = 0;
+        dropped = 0;
+    }
+
+    // Find where the ring left off. Call once LittleFS is mounted.
+    void begin() {
+        uint32_t newest = 0;
+        int newestSlot = -1;
+        File file = LittleFS.open(HISTORY_FILE, "r");
+        if (file) {
+            size_t pages = file.size() / sizeof(HistoryPage);
+            for (size_t i = 0; i < pages && i < HISTORY_PAGES; i++) {
+                HistoryPageHeader header;
+                file.seek(i * sizeof(HistoryPage));
+                if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                    header.magic == HISTORY_MAGIC &&
+                    (newestSlot < 0 || (int32_t)(header.sequence - newest) > 0)) {
+                    newest = header.sequence;
+                    newestSlot = i;
+                }
+            }
+            file.close();
+        }
+
+        // Start a fresh page after the newest one
+        page.header.magic = HISTORY_MAGIC;
+        page.header.sequence = newest + 1;
+        page.header.count = 0;
+        slot = newestSlot < 0 ? 0 : (newestSlot + 1) % HISTORY_PAGES;
+
+        beginDays();
+    }
+
+    // Add a completed cycle. RAM only - flush() does the writing, unless
+    // the page is already full.
+    void append(int motor, long day, int cycle, uint32_t halfSteps, int target, uint8_t flags) {
+        if (page.header.count >= HISTORY_PAGE_RECORDS && !nextPage()) {
+            dropped++;
+            return;
+        }
+
+        CycleRecord& record = page.records[page.header.count++];
+        time_t now = time(nullptr);
+        record.time = now >= MIN_VALID_EPOCH ? (uint32_t)now : 0;
+        record.day = day;
+        record.halfSteps = halfSteps;
+        record.cycle = cycle;
+        record.motor = motor;
+        record.flags = flags;
+        if (!pageDirty) {
+            pageDirty = true;
+            pageSince = millis();
+        }
+        appended++;
+
+        // Days are only known once the clock has synced
+        if (day != NO_DAY) {
+            DayRecord& totals = openDay(motor - 1, day);
+            totals.halfSteps += halfSteps;
+            totals.cycles++;
+            totals.target = target;
+            openDirty[motor - 1] = true;
+        }
+    }
+
+    // Open a motor's totals for a new day, so a day that doesn't get a
+    // single cycle still records what was planned for it
+    void startDay(int motor, long day, int target) {
+        DayRecord& totals = openDay(motor - 1, day);
+        totals.target = target;
+        openDirty[motor - 1] = true;
+    }
+
+    // True once a page is full, a day has ended, or a partial page has
+    // waited long enough
+    bool isDue() {
+        return msUntilDue() == 0;
+    }
+
+    // Milliseconds until isDue(), ULONG_MAX if nothing is pending
+    unsigned long msUntilDue() {
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            if (closedPending[m]) {
+                return 0;
+            }
+        }
+        if (!pageDirty) {
+            return ULONG_MAX;
+        }
+        if (page.header.count >= HISTORY_PAGE_RECORDS) {
+            return 0;
+        }
+        unsigned long waited = millis() - pageSince;
+        return waited >= HISTORY_FLUSH_MS ? 0 : HISTORY_FLUSH_MS - waited;
+    }
+
+    // Write what is pending. A partial page is written in its slot and
+    // written again as it fills.
+    bool flush() {
+        bool ok = true;
+        if (page.header.count >= HISTORY_PAGE_RECORDS) {
+            ok = nextPage();
+        } else if (pageDirty) {
+            ok = writePage();
+            if (ok) {
+                pageDirty = false;
+            }
+        }
+
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            if (closedPending[m] && writeDay(closedDays[m])) {
+                closedPending[m] = false;
+            }
+            if (openDirty[m] && writeDay(openDays[m])) {
+                openDirty[m] = false;
+            }
+        }
+        flushes++;
+        return ok;
+    }
+
+    // Copy of the page still in RAM, for readers
+    void getPage(HistoryPage& copy, int& pageSlot) {
+        copy = page;
+        pageSlot = slot;
+    }
+
+    // Totals of a motor (from 0) for a day, with anything not yet written
+    // taken from RAM. False if nothing was recorded that day.
+    bool getDay(int index, long day, DayRecord& totals) {
+        if (openDays[index].motor && openDays[index].day == day) {
+            totals = openDays[index];
+            return true;
+        }
+        if (closedPending[index] && closedDays[index].day == day) {
+            totals = closedDays[index];
+            return true;
+        }
+        return readDay(index, day, totals);
+    }
+
+    // Newest day with totals, NO_DAY if none
+    long getLatestDay() {
+        return latestDay;
+    }
+
+    uint32_t getAppended() {
+        return appended;
+    }
+
+    uint32_t getFlushes() {
+        return flushes;
+    }
+
+    uint32_t getDropped() {
+        return dropped;
+    }
+
+    // Read a page from the ring. False for slots never written or damaged.
+    static bool readPage(int pageSlot, HistoryPage& out) {
+        File file = LittleFS.open(HISTORY_FILE, "r");
+        if (!file) {
+            return false;
+        }
+        bool ok = file.seek(pageSlot * sizeof(HistoryPage)) &&
+                  file.read((uint8_t*)&out, sizeof(out)) == sizeof(out);
+        file.close();
+        return ok && out.header.magic == HISTORY_MAGIC &&
+               out.header.count <= HISTORY_PAGE_RECORDS &&
+               out.header.crc == pageCrc(out);
+    }
+
+private:
+    static uint32_t pageCrc(const HistoryPage& p) {
+        return crc32Update(p.records, p.header.count * sizeof(CycleRecord),
+                           crc32Update(&p.header, offsetof(HistoryPageHeader, crc)));
+    }
+
+    static size_t daySlot(int index, long day) {
+        return ((size_t)(day % HISTORY_DAYS) * MOTOR_COUNT + index) * sizeof(DayRecord);
+    }
+
+    // Switch a motor's totals to the given day, setting the previous one
+    // aside for flash. Picks up totals already written for that day, e.g.
+    // before a reset.
+    DayRecord& openDay(int index, long day) {
+        DayRecord& totals = openDays[index];
+        if (totals.motor && totals.day == day) {
+            return totals;
+        }
+        if (totals.motor && openDirty[index]) {
+            closedDays[index] = totals;
+            closedPending[index] = true;
+            openDirty[index] = false;
+        }
+        if (!readDay(index, day, totals)) {
+            memset(&totals, 0, sizeof(totals));
+            totals.day = day;
+            totals.motor = index + 1;
+        }
+        if (latestDay == NO_DAY || day > latestDay) {
+            latestDay = day;
+        }
+        return totals;
+    }
+
+    // Size the day file for HISTORY_DAYS x MOTOR_COUNT slots, starting over
+    // if either changed, and find the newest day in it
+    void beginDays() {
+        const size_t size = (size_t)HISTORY_DAYS * MOTOR_COUNT * sizeof(DayRecord);
+        File file = LittleFS.open(HISTORY_DAYS_FILE, "r");
+        bool sized = file && file.size() == size;
+        if (sized) {
+            DayRecord chunk[MOTOR_COUNT];
+            for (int d = 0; d < HISTORY_DAYS; d++) {
+                if (file.read((uint8_t*)chunk, sizeof(chunk)) != sizeof(chunk)) {
+                    break;
+                }
+                for (int m = 0; m < MOTOR_COUNT; m++) {
+                    if (chunk[m].motor == m + 1 &&
+                        (latestDay == NO_DAY || chunk[m].day > latestDay)) {
+                        latestDay = chunk[m].day;
+                    }
+                }
+            }
+        }
+        if (file) {
+            file.close();
+        }
+        if (sized) {
+            return;
+        }
+
+        file = LittleFS.open(HISTORY_DAYS_FILE, "w");
+        if (!file) {
+            Serial.println("Failed to create history day file");
+            return;
+        }
+        uint8_t zeros[64] = {};
+        for (size_t left = size; left > 0;) {
+            size_t n = left < sizeof(zeros) ? left : sizeof(zeros);
+            file.write(zeros, n);
+            left -= n;
+        }
+        file.close();
+    }
+
+    // A slot only holds the day if the day and motor match
+    bool readDay(int index, long day, DayRecord& totals) {
+        File file = LittleFS.open(HISTORY_DAYS_FILE, "r");
+        if (!file) {
+            return false;
+        }
+        DayRecord stored;
+        bool ok = file.seek(daySlot(index, day)) &&
+                  file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored);
+        file.close();
+        if (!ok || stored.motor != index + 1 || stored.day != day) {
+            return false;
+        }
+        totals = stored;
+        return true;
+    }
+
+    bool writeDay(const DayRecord& totals) {
+        File file = LittleFS.open(HISTORY_DAYS_FILE, "r+");
+        if (!file) {
+            return false;
+        }
+        bool ok = file.seek(daySlot(totals.motor - 1, totals.day)) &&
+                  file.write((const uint8_t*)&totals, sizeof(totals)) == sizeof(totals);
+        file.close();
+        return ok;
+    }
+
+    // Write out a full page and start the next one in the ring
+    bool nextPage() {
+        if (pageDirty && !writePage()) {
+            return false;
+        }
+        pageDirty = false;
+        slot = (slot + 1) % HISTORY_PAGES;
+        page.header.sequence++;
+        page.header.count = 0;
+        return true;
+    }
+
+    // Slots are filled in order, so the one written is never past the end
+    // of the file
+    bool writePage() {
+        page.header.crc = pageCrc(page);
+        File file = LittleFS.exists(HISTORY_FILE) ? LittleFS.open(HISTORY_FILE, "r+")
+                                                  : LittleFS.open(HISTORY_FILE, "w");
+        if (!file) {
+            Serial.println("Failed to open history log");
+            return false;
+        }
+        bool ok = file.seek(slot * sizeof(HistoryPage)) &&
+                  file.write((const uint8_t*)&page, sizeof(page)) == sizeof(page);
+        file.close();
+        return ok;
+    }
+};
+
+#endif // HISTORY_LOG_H
@@ -0,0 +1,136 @@
+#ifndef IDLE_GOVERNOR_H
+#define IDLE_GOVERNOR_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "config.h"
+#ifdef ARDUINO_ARCH_ESP8266
+#include <coredecls.h>
+#endif
+
+// What loop() does with the time until the next deadline
+enum IdleMode {
+    IDLE_BUSY,          // Spin through loop() (no power saving)
+    IDLE_DELAY,         // Bounded delay(), radio always on
+    IDLE_MODEM_SLEEP,   // Delay with the radio off between beacons
+    IDLE_LIGHT_SLEEP    // As modem sleep, plus light sleep while no motor runs
+};
+
+const char* const IDLE_MODE_NAMES[] = {
+    "busy", "delay", "modem", "light"
+};
+
+// Power states the time is accounted to
+enum PowerState {
+    POWER_ACTIVE,       // Running loop()
+    POWER_IDLE,         // Delaying with the radio on
+    POWER_MODEM_SLEEP,
+    POWER_LIGHT_SLEEP,
+    POWER_STATE_COUNT
+};
+
+const char* const POWER_STATE_NAMES[POWER_STATE_COUNT] = {
+    "active", "idle", "modem", "light"
+};
+
+// Idle governor.
+// Sleeps between loop() iterations for as long as nothing is due, up to
+// IDLE_MAX_DELAY_MS. Light sleep stops the CPU clock and with it timer1, so
+// it is only used while no motor is running; bursts fall back to modem
+// sleep, which leaves the step interrupt alone. Web handlers call wake() so
+// a queued command doesn't wait out the delay.
+class IdleGovernor {
+private:
+    IdleMode mode;
+    WiFiSleepType_t appliedSleep;
+    uint64_t stateUs[POWER_STATE_COUNT];
+    uint32_t lastMark;
+
+public:
+    IdleGovernor() {
+        mode = (IdleMode)IDLE_MODE;
+        appliedSleep = WIFI_NONE_SLEEP;
+        for (int i = 0; i < POWER_STATE_COUNT; i++) {
+            stateUs[i] = 0;
+        }
+        lastMark = 0;
+    }
+
+    void begin() {
+        lastMark = micros();
+    }
+
+    // Call at the end of loop() with the time until the next deadline
+    void idle(unsigned long msUntilWork, bool motorsRunning, bool apActive) {
+        uint32_t now = micros();
+        stateUs[POWER_ACTIVE] += now - lastMark;
+        lastMark = now;
+
+        unsigned long ms = msUntilWork < IDLE_MAX_DELAY_MS ? msUntilWork : IDLE_MAX_DELAY_MS;
+        if (mode == IDLE_BUSY || ms == 0) {
+            yield();
+            return;
+        }
+
+        // The SDK doesn't sleep the radio while the setup AP is up
+        PowerState state = POWER_IDLE;
+        WiFiSleepType_t sleep = WIFI_NONE_SLEEP;
+        if (!apActive) {
+            if (mode == IDLE_LIGHT_SLEEP && !motorsRunning) {
+                sleep = WIFI_LIGHT_SLEEP;
+                state = POWER_LIGHT_SLEEP;
+            } else if (mode >= IDLE_MODEM_SLEEP) {
+                sleep = WIFI_MODEM_SLEEP;
+                state = POWER_MODEM_SLEEP;
+            }
+        }
+        if (sleep != appliedSleep) {
+            WiFi.setSleepMode(sleep);
+            appliedSleep = sleep;
+        }
+
+#ifdef ARDUINO_ARCH_ESP8266
+        // Returns early if wake() is called from the network stack
+        esp_delay(ms);
+#else
+        delay(ms);
+#endif
+
+        now = micros();
+        stateUs[state] += now - lastMark;
+        lastMark = now;
+    }
+
+    // Cut a delay short - call from web handlers after queuing work
+    static void wake() {
+#ifdef ARDUINO_ARCH_ESP8266
+        esp_schedule();
+#endif
+    }
+
+    IdleMode getMode() {
+        return mode;
+    }
+
+    uint64_t getStateUs(PowerState state) {
+        return stateUs[state];
+    }
+
+    // Estimated average ESP8266 supply current (not counting the motors),
+    // from the time spent in each state and typical datasheet figures
+    float getAverageCurrentMa() {
+        static const float CURRENT_MA[POWER_STATE_COUNT] = {
+            CURRENT_ACTIVE_MA, CURRENT_IDLE_MA, CURRENT_MODEM_SLEEP_MA, CURRENT_LIGHT_SLEEP_MA
+        };
+
+        uint64_t total = 0;
+        float weighted = 0;
+        for (int i = 0; i < POWER_STATE_COUNT; i++) {
+            total += stateUs[i];
+            weighted += (float)stateUs[i] * CURRENT_MA[i];
+        }
+        return total ? weighted / (float)total : 0;
+    }
+};
+
+#endif // IDLE_GOVERNOR_H
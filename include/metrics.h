@@ -0,0 +1,217 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#ifdef UMM_STATS_FULL
+#include <umm_malloc/umm_malloc_cfg.h>
+#endif
+
+// Stages of loop() that are timed separately
+enum LoopStage {
+    STAGE_DNS,          // Captive portal DNS
+    STAGE_MDNS,         // mDNS responder
+    STAGE_COMMANDS,     // Applying queued web commands
+    STAGE_WIFI,         // WiFi connection and scan polling
+    STAGE_SCHEDULER,    // Both schedulers
+    STAGE_LOOP,         // Whole loop() iteration
+    STAGE_COUNT
+};
+
+const char* const LOOP_STAGE_NAMES[STAGE_COUNT] = {
+    "dns", "mdns", "commands", "wifi", "scheduler", "loop"
+};
+
+// Fixed-bucket log2 histogram of CPU cycle counts.
+// Bucket i counts samples in [2^i, 2^(i+1)) cycles, so recording is a
+// count-leading-zeros and an increment - cheap enough for every iteration.
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 32;
+
+private:
+    uint32_t buckets[BUCKETS];
+    uint32_t count;
+    uint64_t sum;               // 64-bit, 32 would wrap within minutes
+    uint32_t maxCycles;
+
+public:
+    LatencyHistogram() {
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < BUCKETS; i++) {
+            buckets[i] = 0;
+        }
+        count = 0;
+        sum = 0;
+        maxCycles = 0;
+    }
+
+    void record(uint32_t cycles) {
+        int bucket = 31 - __builtin_clz(cycles | 1);
+        buckets[bucket]++;
+        count++;
+        sum += cycles;
+        if (cycles > maxCycles) {
+            maxCycles = cycles;
+        }
+    }
+
+    // Upper bound of the bucket holding the given percentile
+    uint32_t percentile(int pct) {
+        if (count == 0) {
+            return 0;
+        }
+
+        uint32_t target = (uint32_t)(((uint64_t)count * pct + 99) / 100);
+        uint32_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= target) {
+                uint32_t upper = (i == 31) ? 0xFFFFFFFF : ((1UL << (i + 1)) - 1);
+                return upper < maxCycles ? upper : maxCycles;
+            }
+        }
+        return maxCycles;
+    }
+
+    uint32_t getBucket(int i) {
+        return buckets[i];
+    }
+
+    // Index of the highest non-empty bucket, or -1 if empty
+    int getHighestBucket() {
+        for (int i = BUCKETS - 1; i >= 0; i--) {
+            if (buckets[i]) return i;
+        }
+        return -1;
+    }
+
+    uint32_t getCount() {
+        return count;
+    }
+
+    uint64_t getSum() {
+        return sum;
+    }
+
+    uint32_t getMax() {
+        return maxCycles;
+    }
+};
+
+// Per-stage timing of loop() using the CPU cycle counter.
+// Call beginLoop() at the top of loop(), lap() after each stage and
+// endLoop() at the bottom.
+class LoopMetrics {
+private:
+    LatencyHistogram stages[STAGE_COUNT];
+    uint32_t loopStart;
+    uint32_t lastMark;
+
+public:
+    LoopMetrics() {
+        loopStart = 0;
+        lastMark = 0;
+    }
+
+    void beginLoop() {
+        loopStart = ESP.getCycleCount();
+        lastMark = loopStart;
+    }
+
+    // Record the time since the previous mark against a stage
+    void lap(LoopStage stage) {
+        uint32_t now = ESP.getCycleCount();
+        stages[stage].record(now - lastMark);
+        lastMark = now;
+    }
+
+    // Restart the lap timer without recording (for skipped stages)
+    void skip() {
+        lastMark = ESP.getCycleCount();
+    }
+
+    void endLoop() {
+        stages[STAGE_LOOP].record(ESP.getCycleCount() - loopStart);
+    }
+
+    LatencyHistogram& getStage(LoopStage stage) {
+        return stages[stage];
+    }
+
+    void reset() {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            stages[i].reset();
+        }
+    }
+};
+
+// Requests whose heap use is tracked
+enum RequestKind {
+    REQ_STATUS,
+    REQ_SETTINGS,
+    REQ_COUNT
+};
+
+const char* const REQUEST_KIND_NAMES[REQ_COUNT] = {
+    "status", "settings"
+};
+
+// Peak heap use of a single request handler. With UMM_STATS_FULL the heap's
+// low-water mark is reset at the start, so allocations that are freed again
+// before the handler returns are still counted.
+class HeapProbe {
+private:
+    uint32_t startFree;
+
+public:
+    HeapProbe() {
+        startFree = ESP.getFreeHeap();
+#ifdef UMM_STATS_FULL
+        umm_free_heap_size_min_reset();
+#endif
+    }
+
+    uint32_t peakUse() {
+#ifdef UMM_STATS_FULL
+        uint32_t lowest = umm_free_heap_size_min();
+#else
+        uint32_t lowest = ESP.getFreeHeap();
+#endif
+        return startFree > lowest ? startFree - lowest : 0;
+    }
+};
+
+struct RequestHeapStats {
+    uint32_t count;
+    uint32_t lastPeak;
+    uint32_t maxPeak;
+};
+
+class RequestMetrics {
+private:
+    RequestHeapStats stats[REQ_COUNT];
+
+public:
+    RequestMetrics() {
+        for (int i = 0; i < REQ_COUNT; i++) {
+            stats[i] = {0, 0, 0};
+        }
+    }
+
+    void record(RequestKind kind, uint32_t peakBytes) {
+        stats[kind].count++;
+        stats[kind].lastPeak = peakBytes;
+        if (peakBytes > stats[kind].maxPeak) {
+            stats[kind].maxPeak = peakBytes;
+        }
+    }
+
+    RequestHeapStats& get(RequestKind kind) {
+        return stats[kind];
+    }
+};
+
+#endif // METRICS_H
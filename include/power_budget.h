@@ -0,0 +1,159 @@
+#ifndef POWER_BUDGET_H
+#define POWER_BUDGET_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "stepper.h"
+
+// Motor supply budget.
+// Every energized 28BYJ-48 draws around MOTOR_CURRENT_MA from the shared 5V
+// supply, so bursts that line up (Start All, equal schedules) can brown it
+// out. Schedulers ask here before starting a burst; requests that don't fit
+// are queued and granted oldest first as running bursts end. A motor that
+// needs more than the whole budget may still run on its own.
+class PowerBudget {
+private:
+    Stepper* motors[MOTOR_COUNT];
+    uint16_t currentMa[MOTOR_COUNT];
+    uint8_t queue[MOTOR_COUNT];         // Waiting motor indexes, oldest first
+    unsigned long queuedAt[MOTOR_COUNT];
+    int waiting;
+
+    // Metrics
+    uint32_t peakMa;                    // Highest total granted
+    uint32_t deferred;                  // Bursts that had to wait
+    unsigned long maxWaitMs;
+
+public:
+    PowerBudget() {
+        for (int i = 0; i < MOTOR_COUNT; i++) {
+            motors[i] = nullptr;
+            currentMa[i] = MOTOR_CURRENT_MA;
+        }
+        waiting = 0;
+        peakMa = 0;
+        deferred = 0;
+        maxWaitMs = 0;
+    }
+
+    void attach(int index, Stepper* motor) {
+        motors[index] = motor;
+    }
+
+    // Supply current of one motor while its coils are energized
+    void setCurrent(int index, uint16_t mA) {
+        currentMa[index] = mA;
+    }
+
+    uint16_t getCurrent(int index) {
+        return currentMa[index];
+    }
+
+    // Current drawn by the motors running right now
+    uint32_t energizedMa() {
+        uint32_t total = 0;
+        for (int i = 0; i < MOTOR_COUNT; i++) {
+            if (motors[i] && motors[i]->isRunning()) {
+                total += currentMa[i];
+            }
+        }
+        return total;
+    }
+
+    bool fits(int index) {
+        uint32_t energized = energizedMa();
+        return energized == 0 || energized + currentMa[index] <= MOTOR_BUDGET_MA;
+    }
+
+    // Ask to start a burst. Returns true if the motor may start now;
+    // otherwise it joins the queue and should ask again once nextReady()
+    // names it.
+    bool request(int index) {
+        int position = find(index);
+        if ((waiting == 0 || position == 0) && fits(index)) {
+            if (position == 0) {
+                unsigned long waited = millis() - queuedAt[index];
+                if (waited > maxWaitMs) maxWaitMs = waited;
+                remove(0);
+            }
+            grant(index);
+            return true;
+        }
+        if (position < 0) {
+            queue[waiting++] = index;
+            queuedAt[index] = millis();
+            deferred++;
+        }
+        return false;
+    }
+
+    // Start outside the queue (manual tests) if there is room right now
+    bool claim(int index) {
+        if (!fits(index)) {
+            return false;
+        }
+        grant(index);
+        return true;
+    }
+
+    // Leave the queue without starting
+    void cancel(int index) {
+        int position = find(index);
+        if (position >= 0) {
+            remove(position);
+        }
+    }
+
+    bool isWaiting(int index) {
+        return find(index) >= 0;
+    }
+
+    // The oldest waiting motor, if the budget now has room for it
+    bool nextReady(unsigned int& index) {
+        if (waiting == 0 || !fits(queue[0])) {
+            return false;
+        }
+        index = queue[0];
+        return true;
+    }
+
+    int getWaitingCount() {
+        return waiting;
+    }
+
+    uint32_t getPeakMa() {
+        return peakMa;
+    }
+
+    uint32_t getDeferred() {
+        return deferred;
+    }
+
+    unsigned long getMaxWaitMs() {
+        return maxWaitMs;
+    }
+
+private:
+    int find(int index) {
+        for (int i = 0; i < waiting; i++) {
+            if (queue[i] == index) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void remove(int position) {
+        waiting--;
+        for (int i = position; i < waiting; i++) {
+            queue[i] = queue[i + 1];
+        }
+    }
+
+    void grant(int index) {
+        uint32_t total = energizedMa() + currentMa[index];
+        if (total > peakMa) peakMa = total;
+    }
+};
+
+#endif // POWER_BUDGET_H
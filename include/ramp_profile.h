@@ -0,0 +1,39 @@
+#ifndef RAMP_PROFILE_H
+#define RAMP_PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Constant-acceleration start/stop profile for the 28BYJ-48.
+// Half-step n of the ramp lasts 1 / sqrt(v0^2 + 2*a*n) seconds. The whole
+// table is computed at compile time, so the step interrupt only indexes it.
+
+constexpr double rampSqrt(double x) {
+    // Newton's method - converges well within the iteration budget for the
+    // speed range used here
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 40; i++) {
+        r = 0.5 * (r + x / r);
+    }
+    return r;
+}
+
+struct RampTable {
+    uint16_t intervalUs[RAMP_STEPS];
+
+    constexpr RampTable() : intervalUs() {
+        const double v0 = 1000000.0 / RAMP_START_US;
+        for (int n = 0; n < RAMP_STEPS; n++) {
+            double v = rampSqrt(v0 * v0 + 2.0 * RAMP_ACCEL * n);
+            intervalUs[n] = (uint16_t)(1000000.0 / v + 0.5);
+        }
+    }
+};
+
+// Kept in RAM (not PROGMEM) so the step interrupt never waits on flash
+static constexpr RampTable RAMP_TABLE{};
+
+static_assert(RAMP_START_US <= 65535, "Ramp intervals must fit in uint16_t");
+static_assert(RAMP_TABLE.intervalUs[0] == RAMP_START_US, "Ramp must start at RAMP_START_US");
+
+#endif // RAMP_PROFILE_H
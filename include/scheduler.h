@@ -2,14 +2,19 @@
 #define SCHEDULER_H
 
 #include <Arduino.h>
+#include <limits.h>
 #include "config.h"
 #include "stepper.h"
+#include "power_budget.h"
+#include "history_log.h"
+#include "wall_clock.h"
 
 // Scheduler state
 enum SchedulerState {
     SCHED_IDLE,
     SCHED_WAITING,      // Waiting for next cycle
-    SCHED_ROTATING      // Motor is currently rotating
+    SCHED_ROTATING,     // Motor is currently rotating
+    SCHED_SLEEPING      // Outside the active window or done for the day
 };
 
 // Motor settings structure
@@ -17,57 +22,115 @@ struct MotorSettings {
     bool enabled;
     Direction direction;
     int turnsPerDay;       // TPD
-    int activeHours;       // Hours of operation per day
-    int rotationTime;      // Seconds per rotation burst
+    int windowStart;       // Active window, minutes after midnight.
+    int windowEnd;         // Wraps past midnight if end < start; equal = all day
+    int rotationTime;      // Shortest slot per burst, seconds - longer bursts get longer slots
     int restTime;          // Minutes between rotations
+    int rpm;               // Rotation speed during bursts
+    DriveMode driveMode;
 
     // Calculated values
+    int activeHours;
     float turnsPerCycle;
     int cyclesPerDay;
+    unsigned long burstMs;         // How long turnsPerCycle takes at rpm
     unsigned long cycleDurationMs;
+    bool tpdReachable;             // False if TPD takes longer than the window at rpm
+};
+
+// Progress that has to survive a reset. Fixed-width, since it is stored
+// raw in RTC memory and on flash.
+struct SchedulerCheckpoint {
+    uint8_t running;
+    uint8_t rotating;           // Reset hit mid-burst
+    uint16_t completedCycles;
+    uint32_t stepsToday;        // Half-steps
+    uint32_t stepsThisCycle;    // Half-steps of the interrupted burst
+    uint32_t msSinceCycle;      // Time since the last cycle started
+    int32_t windowDay;          // Wall-clock day of the counters, or NO_DAY
 };
 
 class Scheduler {
 private:
     Stepper* motor;
+    PowerBudget* budget;        // Optional - bursts start unconditionally without one
+    HistoryLog* history;        // Optional - completed cycles are logged here
     MotorSettings settings;
-    unsigned long lastCycleTime;
+    uint32_t lastCycleTime;     // millis() times are 32-bit, so differences hold across the wrap
     int completedCycles;
-    float totalTurnsToday;
+    unsigned long totalStepsToday;     // Half-steps, so turns never drift
     bool isRunning;
     int motorId;
     SchedulerState state;
 
+    // Day the counters belong to, on the wall clock and on the uptime clock
+    // used before SNTP has synced
+    long windowDay;
+    long uptimeDay;
+    uint32_t wakeAt;            // Next time to look at the clock while sleeping
+    uint32_t sleepUntil;        // When the sleep actually ends
+
 public:
+    // Unattached - call attach() before changing settings
+    Scheduler() : Scheduler(nullptr, 0) {
+    }
+
     Scheduler(Stepper* stepper, int id) {
         motor = stepper;
+        budget = nullptr;
+        history = nullptr;
         motorId = id;
         lastCycleTime = 0;
         completedCycles = 0;
-        totalTurnsToday = 0;
+        totalStepsToday = 0;
         isRunning = false;
         state = SCHED_IDLE;
+        windowDay = NO_DAY;
+        uptimeDay = NO_DAY;
+        wakeAt = 0;
+        sleepUntil = 0;
 
         // Initialize with defaults
         settings.enabled = true;
         settings.direction = (Direction)DEFAULT_DIRECTION;
         settings.turnsPerDay = DEFAULT_TPD;
-        settings.activeHours = DEFAULT_ACTIVE_HOURS;
+        settings.windowStart = DEFAULT_WINDOW_START;
+        settings.windowEnd = DEFAULT_WINDOW_END;
         settings.rotationTime = DEFAULT_ROTATION_TIME;
         settings.restTime = DEFAULT_REST_TIME;
+        settings.rpm = DEFAULT_RPM;
+        settings.driveMode = DRIVE_HALF;
 
         calculateSchedule();
     }
 
-    void calculateSchedule() {
-        // Calculate cycle duration in milliseconds
-        // Cycle = rotation time + rest time
-        settings.cycleDurationMs = (unsigned long)(settings.rotationTime * 1000) +
-                                   (unsigned long)(settings.restTime * 60 * 1000);
+    void attach(Stepper* stepper, int id, PowerBudget* powerBudget = nullptr,
+                HistoryLog* historyLog = nullptr) {
+        motor = stepper;
+        motorId = id;
+        budget = powerBudget;
+        history = historyLog;
+    }
 
-        // Calculate cycles per day based on active hours
-        unsigned long activeMs = (unsigned long)settings.activeHours * 60 * 60 * 1000;
-        settings.cyclesPerDay = activeMs / settings.cycleDurationMs;
+    void calculateSchedule() {
+        unsigned long activeMinutes = windowLength();
+        settings.activeHours = activeMinutes / 60;
+        unsigned long activeMs = activeMinutes * 60 * 1000;
+        unsigned long slotMs = (unsigned long)settings.rotationTime * 1000;
+        unsigned long restMs = (unsigned long)settings.restTime * 60 * 1000;
+
+        // Time the whole day's turns take at speed
+        unsigned long turningMs = (unsigned long)settings.turnsPerDay * 60000UL / settings.rpm;
+        settings.tpdReachable = turningMs <= activeMs;
+
+        // Cycle = burst slot + rest time. Bursts longer than the slot
+        // stretch it, so the window is then shared out as the turning time
+        // plus as many rests as still fit.
+        settings.cyclesPerDay = activeMs / (slotMs + restMs);
+        if (settings.cyclesPerDay > 0 && turningMs / settings.cyclesPerDay > slotMs) {
+            settings.cyclesPerDay = settings.tpdReachable && restMs > 0
+                                        ? (activeMs - turningMs) / restMs : 1;
+        }
 
         // Ensure at least 1 cycle
         if (settings.cyclesPerDay < 1) {
@@ -76,22 +139,75 @@ public:
 
         // Calculate turns needed per cycle to achieve TPD
         settings.turnsPerCycle = (float)settings.turnsPerDay / (float)settings.cyclesPerDay;
+
+        // Rounded up, so the rest that follows is never cut short
+        unsigned long perCycle = (unsigned long)settings.rpm * settings.cyclesPerDay;
+        settings.burstMs = ((unsigned long)settings.turnsPerDay * 60000UL + perCycle - 1) / perCycle;
+        settings.cycleDurationMs = max(slotMs, settings.burstMs) + restMs;
+    }
+
+    // Steps in the motor's drive mode for a given cycle of the day. The daily
+    // total rarely divides evenly, so the remainder is spread Bresenham-style:
+    // cycle k gets floor((k+1)*D/C) - floor(k*D/C), and the day always sums
+    // to exactly D.
+    unsigned long stepsForCycle(int cycle) {
+        uint64_t dailySteps = (uint64_t)settings.turnsPerDay * motor->getStepsPerRevolution();
+        uint64_t cycles = (uint64_t)settings.cyclesPerDay;
+        uint64_t before = (dailySteps * (uint64_t)cycle) / cycles;
+        uint64_t after = (dailySteps * (uint64_t)(cycle + 1)) / cycles;
+        return (unsigned long)(after - before);
+    }
+
+    // Minutes in the active window
+    int windowLength() {
+        int length = settings.windowEnd - settings.windowStart;
+        return length > 0 ? length : length + MINUTES_PER_DAY;
     }
 
-    void setSettings(bool enabled, int direction, int tpd, int activeHours,
-                     int rotationTime, int restTime) {
+    bool inWindow(const ClockReading& clock) {
+        if (!clock.synced || settings.windowStart == settings.windowEnd) {
+            return true;  // No time of day yet, or all day
+        }
+        if (settings.windowStart < settings.windowEnd) {
+            return clock.minute >= settings.windowStart && clock.minute < settings.windowEnd;
+        }
+        return clock.minute >= settings.windowStart || clock.minute < settings.windowEnd;
+    }
+
+    void setSettings(bool enabled, int direction, int tpd, int windowStart,
+                     int windowEnd, int rotationTime, int restTime, int rpm,
+                     int driveMode) {
         settings.enabled = enabled;
         settings.direction = (Direction)direction;
-        settings.turnsPerDay = tpd;
-        settings.activeHours = activeHours;
-        settings.rotationTime = rotationTime;
-        settings.restTime = restTime;
+        // Within what the settings record stores, and a slot of at least a
+        // second so a cycle never lasts zero time
+        settings.turnsPerDay = constrain(tpd, 0, UINT16_MAX);
+        settings.windowStart = constrain(windowStart, 0, MINUTES_PER_DAY - 1);
+        settings.windowEnd = constrain(windowEnd, 0, MINUTES_PER_DAY - 1);
+        settings.rotationTime = constrain(rotationTime, 1, UINT16_MAX);
+        settings.restTime = constrain(restTime, 0, UINT16_MAX);
+        settings.rpm = constrain(rpm, MIN_RPM, MAX_RPM);
+        settings.driveMode = (DriveMode)constrain(driveMode, DRIVE_HALF, DRIVE_WAVE);
+        motor->setRpm(settings.rpm);
+        motor->setDriveMode(settings.driveMode);
+
+        // Wave drive only ever energizes one of the two coils
+        if (budget) {
+            budget->setCurrent(motorId - 1, settings.driveMode == DRIVE_WAVE
+                                                 ? MOTOR_CURRENT_MA / 2 : MOTOR_CURRENT_MA);
+        }
 
         calculateSchedule();
 
-        // Reset daily counters when settings change
+        // Reset daily counters when settings change, and look at the
+        // window again on the next update
         completedCycles = 0;
-        totalTurnsToday = 0;
+        totalStepsToday = 0;
+        windowDay = NO_DAY;
+        if (state == SCHED_SLEEPING) {
+            state = SCHED_WAITING;
+        }
+        leaveBudgetQueue();
     }
 
     MotorSettings getSettings() {
@@ -108,6 +224,7 @@ public:
     void stop() {
         isRunning = false;
         state = SCHED_IDLE;
+        leaveBudgetQueue();
         motor->stop();
         Serial.printf("Motor %d: Scheduler stopped\n", motorId);
     }
@@ -121,37 +238,68 @@ public:
     }
 
     float getTotalTurns() {
-        return totalTurnsToday;
+        return (float)totalStepsToday / (float)HALF_STEPS_PER_REVOLUTION;
     }
 
     void resetDailyCounters() {
         completedCycles = 0;
-        totalTurnsToday = 0;
+        totalStepsToday = 0;
     }
 
     // Call this in the main loop - NON-BLOCKING
-    bool update() {
+    bool update(const ClockReading& clock) {
         if (!isRunning || !settings.enabled) {
             return false;
         }
 
-        unsigned long currentTime = millis();
+        uint32_t currentTime = millis();
+
+        // Asleep until the window opens - nothing to do but one compare.
+        // Signed difference, so this holds across the millis() wrap.
+        if (state == SCHED_SLEEPING) {
+            if ((int32_t)(currentTime - wakeAt) < 0) {
+                return false;
+            }
+            state = SCHED_WAITING;
+        }
 
         switch (state) {
             case SCHED_IDLE:
+            case SCHED_SLEEPING:
                 return false;
 
             case SCHED_WAITING:
+                rollOver(clock, currentTime);
+
+                if (!inWindow(clock)) {
+                    sleep(msUntilMinute(settings.windowStart, clock), currentTime);
+                    return false;
+                }
+
                 // Check if enough time has passed for next cycle
                 if (currentTime - lastCycleTime >= settings.cycleDurationMs) {
                     // Check if we've reached daily target
                     if (completedCycles >= settings.cyclesPerDay) {
-                        return false;  // Done for today
+                        // Done for today - sleep until the next day starts
+                        sleep(msUntilMinute(clock.synced ? settings.windowStart : 0, clock),
+                              currentTime);
+                        return false;
                     }
 
-                    // Start the rotation (non-blocking)
-                    lastCycleTime = currentTime;
-                    motor->startRotation(settings.rotationTime, settings.direction);
+                    // Wait for room on the motor supply
+                    if (budget && !budget->request(motorId - 1)) {
+                        return false;
+                    }
+
+                    // A start held back by the budget keeps the original
+                    // cadence, so queueing never costs a cycle
+                    uint32_t due = lastCycleTime + settings.cycleDurationMs;
+                    lastCycleTime = currentTime - due < settings.cycleDurationMs ? due : currentTime;
+
+                    // Start the rotation (non-blocking). The burst ends after
+                    // an exact step count, not a duration, so TPD doesn't
+                    // depend on step timing.
+                    motor->startSteps(stepsForCycle(completedCycles), settings.direction);
                     state = SCHED_ROTATING;
 
                     Serial.printf("Motor %d: Starting cycle %d/%d\n",
@@ -160,16 +308,20 @@ public:
                 return false;
 
             case SCHED_ROTATING:
-                // Update motor (non-blocking step)
-                if (!motor->update()) {
+                // Steps are issued by the step engine - just watch for the end
+                if (!motor->isRunning()) {
                     // Motor finished rotating
                     float turnsCompleted = motor->getTurnsCompleted();
-                    totalTurnsToday += turnsCompleted;
+                    totalStepsToday += motor->getHalfStepsCompleted();
                     completedCycles++;
+                    if (history) {
+                        history->append(motorId, windowDay, completedCycles,
+                                        motor->getHalfStepsCompleted(), settings.cyclesPerDay, 0);
+                    }
 
                     Serial.printf("Motor %d: Cycle %d/%d complete, Turns: %.2f, Total: %.2f\n",
                                  motorId, completedCycles, settings.cyclesPerDay,
-                                 turnsCompleted, totalTurnsToday);
+                                 turnsCompleted, getTotalTurns());
 
                     state = SCHED_WAITING;
                     return true;  // Cycle was completed
@@ -180,16 +332,143 @@ public:
         return false;
     }
 
+    // Milliseconds until update() has something to do
+    unsigned long msUntilNextWork() {
+        if (!isRunning || !settings.enabled) {
+            return ULONG_MAX;
+        }
+
+        uint32_t currentTime = millis();
+        switch (state) {
+            case SCHED_ROTATING:
+                return ULONG_MAX;  // The step engine reports the end of the burst
+
+            case SCHED_SLEEPING: {
+                int32_t remaining = (int32_t)(wakeAt - currentTime);
+                return remaining > 0 ? remaining : 0;
+            }
+
+            case SCHED_WAITING: {
+                if (budget && budget->isWaiting(motorId - 1)) {
+                    return ULONG_MAX;  // Run again once the budget has room
+                }
+                uint32_t elapsed = currentTime - lastCycleTime;
+                return elapsed >= settings.cycleDurationMs ? 0 : settings.cycleDurationMs - elapsed;
+            }
+
+            default:
+                return ULONG_MAX;
+        }
+    }
+
+    // Reset the daily counters when a new day's window opens. Until SNTP
+    // has synced, days are counted from boot instead - but only if the wall
+    // clock has never been seen, so a reboot doesn't cause a second reset
+    // once the time comes back.
+    void rollOver(const ClockReading& clock, uint32_t currentTime) {
+        if (clock.synced) {
+            // A window that opened before midnight still belongs to yesterday
+            long day = clock.minute >= settings.windowStart ? clock.day : clock.day - 1;
+            if (day == windowDay) {
+                return;
+            }
+            bool first = windowDay == NO_DAY;
+            windowDay = day;
+            if (history) {
+                history->startDay(motorId, day, settings.cyclesPerDay);
+            }
+            if (first) {
+                return;
+            }
+        } else {
+            if (windowDay != NO_DAY) {
+                return;
+            }
+            if (uptimeDay == NO_DAY) {
+                uptimeDay = clock.day;
+                return;
+            }
+            if (clock.day == uptimeDay) {
+                return;
+            }
+            uptimeDay = clock.day;
+        }
+
+        resetDailyCounters();
+        lastCycleTime = currentTime - settings.cycleDurationMs;  // First cycle right away
+        Serial.printf("Motor %d: New day, counters reset\n", motorId);
+    }
+
+    // Milliseconds from now until the clock next reads the given minute
+    static long msUntilMinute(int minute, const ClockReading& clock) {
+        long minutes = (minute - clock.minute + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+        long ms = minutes * 60000L - clock.second * 1000L;
+        return ms > 0 ? ms : ms + MINUTES_PER_DAY * 60000L;
+    }
+
+    // Wake up at least every SCHED_MAX_SLEEP_MS so clock corrections (first
+    // sync, DST) are picked up
+    void sleep(long ms, uint32_t currentTime) {
+        leaveBudgetQueue();
+        sleepUntil = currentTime + ms;
+        wakeAt = currentTime + (ms < SCHED_MAX_SLEEP_MS ? ms : SCHED_MAX_SLEEP_MS);
+        state = SCHED_SLEEPING;
+    }
+
+    // A queued start that no longer applies mustn't hold up the motors
+    // queued behind it
+    void leaveBudgetQueue() {
+        if (budget) {
+            budget->cancel(motorId - 1);
+        }
+    }
+
     // Get status as JSON-compatible values
     void getStatus(bool& running, int& cycles, int& totalCycles,
                    float& turns, int& targetTpd) {
         running = isRunning;
         cycles = completedCycles;
         totalCycles = settings.cyclesPerDay;
-        turns = totalTurnsToday;
+        turns = getTotalTurns();
         targetTpd = settings.turnsPerDay;
     }
 
+    void getCheckpoint(SchedulerCheckpoint& cp) {
+        cp.running = isRunning;
+        cp.rotating = state == SCHED_ROTATING;
+        cp.completedCycles = completedCycles;
+        cp.stepsToday = totalStepsToday;
+        cp.stepsThisCycle = cp.rotating ? motor->getHalfStepsCompleted() : 0;
+        cp.msSinceCycle = (uint32_t)millis() - lastCycleTime;
+        cp.windowDay = windowDay;
+    }
+
+    // Pick up where a checkpoint left off. Call after settings are loaded,
+    // since changing settings resets the daily counters. A burst cut short
+    // by the reset counts as done with the steps it got, so the watch is
+    // never over-wound.
+    void restore(const SchedulerCheckpoint& cp) {
+        completedCycles = cp.completedCycles;
+        totalStepsToday = cp.stepsToday;
+        windowDay = cp.windowDay;
+        if (cp.rotating) {
+            completedCycles++;
+            totalStepsToday += cp.stepsThisCycle;
+            if (history) {
+                history->append(motorId, windowDay, completedCycles, cp.stepsThisCycle,
+                                settings.cyclesPerDay, CYCLE_INTERRUPTED);
+            }
+        }
+
+        if (cp.running) {
+            isRunning = true;
+            state = SCHED_WAITING;
+            lastCycleTime = millis() - cp.msSinceCycle;
+            Serial.printf("Motor %d: Resumed at cycle %d/%d\n",
+                          motorId, completedCycles, settings.cyclesPerDay);
+        }
+    }
+
     // Check if motor is actively rotating right now
     bool isMotorActive() {
         return state == SCHED_ROTATING;
@@ -205,7 +484,12 @@ public:
             return 0;  // Currently rotating
         }
 
-        unsigned long elapsed = millis() - lastCycleTime;
+        if (state == SCHED_SLEEPING) {
+            int32_t remaining = (int32_t)(sleepUntil - (uint32_t)millis());
+            return remaining > 0 ? remaining / 1000 : 0;
+        }
+
+        uint32_t elapsed = (uint32_t)millis() - lastCycleTime;
         if (elapsed >= settings.cycleDurationMs) {
             return 0;
         }
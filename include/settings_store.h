@@ -0,0 +1,257 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <limits.h>
+#include "config.h"
+#include "crc32.h"
+
+// Settings as stored on flash. Fixed-width fields only - the layout is the
+// file format. Version 1 is the first binary record; the JSON file before it
+// is migrated by main.cpp. Changing the layout needs a version bump, with
+// older records converted on load.
+struct StoredMotorSettings {
+    uint8_t enabled;
+    uint8_t direction;
+    uint8_t rpm;
+    uint8_t driveMode;      // DriveMode
+    uint16_t turnsPerDay;
+    uint16_t windowStart;   // Minutes after midnight
+    uint16_t windowEnd;
+    uint16_t rotationTime;  // Seconds
+    uint16_t restTime;      // Minutes
+};
+
+// One block per motor, so the record grows with MOTOR_COUNT. A record
+// written for more motors loads the first MOTOR_COUNT; one written for
+// fewer leaves defaults in the rest.
+struct SettingsRecord {
+    char ssid[33];
+    char password[65];
+    uint16_t motorCount;
+    StoredMotorSettings motors[MOTOR_COUNT];
+};
+
+struct SettingsHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;        // Payload bytes
+    uint32_t sequence;      // Higher wins when both slots are valid
+    uint32_t crc;           // Over the fields above plus the payload
+};
+
+const uint32_t SETTINGS_MAGIC = 0x57575331;  // "WWS1"
+const uint16_t SETTINGS_VERSION = 1;
+
+// Write-behind settings persistence on two alternating A/B slot files.
+// Changes only mark the store dirty; the record is written once things have
+// been quiet for SETTINGS_WRITE_DELAY_MS, so a burst of UI saves costs one
+// flash write. Each commit goes to the slot not holding the newest record,
+// so a power cut mid-write leaves the previous settings intact.
+class SettingsStore {
+private:
+    uint32_t sequence;
+    int activeSlot;             // Slot holding the newest record, -1 if none
+    uint32_t lastPayloadCrc;
+    bool dirty;
+    unsigned long dirtySince;
+    unsigned long lastChange;
+
+    // Metrics
+    uint32_t writes;
+    uint32_t skippedWrites;     // Commits that matched what was on flash
+    uint32_t lastWriteUs;
+
+public:
+    SettingsStore() {
+        sequence = 0;
+        activeSlot = -1;
+        lastPayloadCrc = 0;
+        dirty = false;
+        dirtySince = 0;
+        lastChange = 0;
+        writes = 0;
+        skippedWrites = 0;
+        lastWriteUs = 0;
+    }
+
+    // Load the newest valid record over `record`, which should already hold
+    // defaults. Returns false if neither slot is usable.
+    bool load(SettingsRecord& record) {
+        SettingsRecord slotRecord[2];
+        SettingsHeader header[2];
+        bool valid[2];
+        for (int slot = 0; slot < 2; slot++) {
+            slotRecord[slot] = record;
+            valid[slot] = readSlot(slot, slotRecord[slot], header[slot]);
+        }
+
+        int best = -1;
+        if (valid[0] && valid[1]) {
+            // Sequence comparison that survives wraparound
+            best = (int32_t)(header[1].sequence - header[0].sequence) > 0 ? 1 : 0;
+        } else if (valid[0]) {
+            best = 0;
+        } else if (valid[1]) {
+            best = 1;
+        }
+
+        if (best < 0) {
+            return false;
+        }
+
+        record = slotRecord[best];
+        activeSlot = best;
+        sequence = header[best].sequence;
+        lastPayloadCrc = crc32Update(&record, sizeof(record));
+        return true;
+    }
+
+    // Note a change to be written later
+    void markDirty() {
+        unsigned long now = millis();
+        if (!dirty) {
+            dirty = true;
+            dirtySince = now;
+        }
+        lastChange = now;
+    }
+
+    bool isDirty() {
+        return dirty;
+    }
+
+    // True once changes have settled, or have waited too long
+    bool isDue() {
+        if (!dirty) {
+            return false;
+        }
+        unsigned long now = millis();
+        return now - lastChange >= SETTINGS_WRITE_DELAY_MS ||
+               now - dirtySince >= SETTINGS_MAX_DELAY_MS;
+    }
+
+    // Milliseconds until isDue(), ULONG_MAX if nothing is pending
+    unsigned long msUntilDue() {
+        if (!dirty) {
+            return ULONG_MAX;
+        }
+        unsigned long now = millis();
+        unsigned long quiet = now - lastChange;
+        unsigned long waited = now - dirtySince;
+        if (quiet >= SETTINGS_WRITE_DELAY_MS || waited >= SETTINGS_MAX_DELAY_MS) {
+            return 0;
+        }
+        unsigned long untilQuiet = SETTINGS_WRITE_DELAY_MS - quiet;
+        unsigned long untilMax = SETTINGS_MAX_DELAY_MS - waited;
+        return untilQuiet < untilMax ? untilQuiet : untilMax;
+    }
+
+    // Commit a record now. Skips the flash write if nothing changed.
+    bool save(const SettingsRecord& record) {
+        dirty = false;
+
+        uint32_t payloadCrc = crc32Update(&record, sizeof(record));
+        if (activeSlot >= 0 && payloadCrc == lastPayloadCrc) {
+            skippedWrites++;
+            return true;
+        }
+
+        uint32_t start = micros();
+        int slot = activeSlot == 0 ? 1 : 0;
+
+        SettingsHeader header;
+        header.magic = SETTINGS_MAGIC;
+        header.version = SETTINGS_VERSION;
+        header.length = sizeof(SettingsRecord);
+        header.sequence = sequence + 1;
+        header.crc = crc32Update(&record, sizeof(record),
+                                 crc32Update(&header, offsetof(SettingsHeader, crc)));
+
+        File file = LittleFS.open(slotPath(slot), "w");
+        if (!file) {
+            Serial.println("Failed to open settings slot for writing");
+            return false;
+        }
+        bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+        file.close();
+
+        if (!ok) {
+            Serial.println("Failed to write settings");
+            return false;
+        }
+
+        activeSlot = slot;
+        sequence = header.sequence;
+        lastPayloadCrc = payloadCrc;
+        writes++;
+        lastWriteUs = micros() - start;
+        return true;
+    }
+
+    uint32_t getWrites() {
+        return writes;
+    }
+
+    uint32_t getSkippedWrites() {
+        return skippedWrites;
+    }
+
+    uint32_t getLastWriteUs() {
+        return lastWriteUs;
+    }
+
+private:
+    static const char* slotPath(int slot) {
+        return slot == 0 ? SETTINGS_SLOT_A : SETTINGS_SLOT_B;
+    }
+
+    // Reads a slot over `record`. Records written for fewer motors only
+    // cover their own length, leaving later fields as they were; bytes past
+    // the end of this firmware's record are checked but dropped.
+    bool readSlot(int slot, SettingsRecord& record, SettingsHeader& header) {
+        File file = LittleFS.open(slotPath(slot), "r");
+        if (!file) {
+            return false;
+        }
+
+        // Cleared first, so a short read leaves no garbage length behind
+        memset(&header, 0, sizeof(header));
+        SettingsRecord payload = record;
+        bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                  header.magic == SETTINGS_MAGIC &&
+                  header.version <= SETTINGS_VERSION;
+        size_t kept = ok && header.length < sizeof(payload) ? header.length : sizeof(payload);
+        uint32_t crc = 0;
+        if (ok) {
+            ok = file.read((uint8_t*)&payload, kept) == kept;
+            crc = crc32Update(&payload, kept, crc32Update(&header, offsetof(SettingsHeader, crc)));
+        }
+        for (size_t left = ok ? header.length - kept : 0; left > 0;) {
+            uint8_t chunk[32];
+            size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+            ok = file.read(chunk, n) == n;
+            if (!ok) {
+                break;
+            }
+            crc = crc32Update(chunk, n, crc);
+            left -= n;
+        }
+        file.close();
+
+        if (!ok) {
+            return false;
+        }
+        if (crc != header.crc) {
+            Serial.printf("Settings slot %c is corrupt\n", 'A' + slot);
+            return false;
+        }
+
+        record = payload;
+        return true;
+    }
+};
+
+#endif // SETTINGS_STORE_H
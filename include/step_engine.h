@@ -0,0 +1,108 @@
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "stepper.h"
+#include "coil_output.h"
+
+// Interrupt-driven step generation.
+// timer1 fires every STEP_TICK_US and ticks every attached motor, so coil
+// timing no longer depends on how often loop() gets around to it. All coil
+// changes from one tick go out in a single set/clear register write.
+static_assert(STEP_ENGINE_MAX_MOTORS <= 32, "Completion flags are a 32-bit mask");
+
+class StepEngine {
+private:
+    static inline Stepper* motors[STEP_ENGINE_MAX_MOTORS] = {};
+    static inline volatile int motorCount = 0;
+    static inline uint32_t lastTickUs = 0;
+    static inline volatile uint32_t completedMask = 0;  // Bit i: motor i finished a motion
+
+    static void IRAM_ATTR onTimer() {
+        // Measure real elapsed time so a delayed interrupt doesn't stretch the
+        // step rate. 32-bit, so the difference holds across the micros() wrap.
+        uint32_t now = micros();
+        uint32_t elapsedUs = now - lastTickUs;
+        lastTickUs = now;
+
+        // Collect every motor's pin changes, then write them all at once
+        CoilFrame frame = {0, 0};
+        for (int i = 0; i < motorCount; i++) {
+            if (motors[i]->tick(elapsedUs, frame)) {
+                completedMask |= 1UL << i;
+            }
+        }
+        CoilOutput::write(frame);
+    }
+
+public:
+    // Motors that finished a motion since the last call, as a bitmask of
+    // attach order
+    static uint32_t takeCompleted() {
+        noInterrupts();
+        uint32_t mask = completedMask;
+        completedMask = 0;
+        interrupts();
+        return mask;
+    }
+
+    // Register a motor - call before begin()
+    static bool attach(Stepper* motor) {
+        if (motorCount >= STEP_ENGINE_MAX_MOTORS) {
+            return false;
+        }
+        motors[motorCount] = motor;
+        motorCount = motorCount + 1;
+        return true;
+    }
+
+#ifdef ARDUINO_ARCH_ESP8266
+    static void begin() {
+        // timer1 runs from the 80 MHz APB clock: DIV16 gives 5 ticks/us
+        lastTickUs = micros();
+        timer1_isr_init();
+        timer1_attachInterrupt(onTimer);
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+        timer1_write(STEP_TICK_US * 5);
+    }
+
+    // Stop ticking and detach every motor
+    static void end() {
+        timer1_disable();
+        timer1_detachInterrupt();
+        motorCount = 0;
+    }
+
+    static void poll() {
+        // Driven by timer1
+    }
+
+    // Whether loop() has to keep calling poll() while motors run
+    static bool needsPolling() {
+        return false;
+    }
+#else
+    // Targets without timer1 (e.g. host builds) tick from poll() instead
+    static void begin() {
+        lastTickUs = micros();
+    }
+
+    static void end() {
+        motorCount = 0;
+    }
+
+    static void poll() {
+        uint32_t now = micros();
+        if (now - lastTickUs >= STEP_TICK_US) {
+            onTimer();
+        }
+    }
+
+    static bool needsPolling() {
+        return true;
+    }
+#endif
+};
+
+#endif // STEP_ENGINE_H
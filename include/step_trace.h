@@ -0,0 +1,128 @@
+#ifndef STEP_TRACE_H
+#define STEP_TRACE_H
+
+#include <Arduino.h>
+#include <math.h>
+
+// One issued half-step, packed into 4 bytes
+struct StepEvent {
+    uint16_t deltaUs;       // Since the previous step of the motion, saturating
+    uint16_t phaseTarget;   // Phase << 13 | target interval in 8 us units
+
+    uint32_t getTargetUs() const {
+        return (uint32_t)(phaseTarget & 0x1FFF) * 8;
+    }
+
+    int getPhase() const {
+        return phaseTarget >> 13;
+    }
+};
+
+struct StepTraceStats {
+    uint32_t count;
+    float meanUs;           // Interval between steps
+    float stddevUs;
+    int32_t maxOvershootUs; // Furthest a step came after its target interval
+    uint32_t missed;        // Steps a whole interval or more late
+};
+
+// Ring buffer of the most recent steps of one motor, written from the step
+// engine interrupt: one 4-byte store and a counter bump per step. The
+// buffer only exists while tracing is switched on.
+class StepTrace {
+private:
+    StepEvent* events;
+    uint16_t capacity;          // Power of two
+    volatile uint32_t written;  // Events recorded since begin()
+
+public:
+    StepTrace() {
+        events = nullptr;
+        capacity = 0;
+        written = 0;
+    }
+
+    // Allocate room for `size` events, rounded down to a power of two.
+    // Detach the trace from its motor before calling.
+    bool begin(uint16_t size) {
+        end();
+        uint16_t rounded = 1;
+        while ((uint32_t)rounded * 2 <= size) {
+            rounded *= 2;
+        }
+        events = (StepEvent*)malloc(rounded * sizeof(StepEvent));
+        if (events == nullptr) {
+            return false;
+        }
+        capacity = rounded;
+        written = 0;
+        return true;
+    }
+
+    void end() {
+        free(events);
+        events = nullptr;
+        capacity = 0;
+    }
+
+    bool isActive() {
+        return events != nullptr;
+    }
+
+    void IRAM_ATTR record(unsigned long deltaUs, unsigned long targetUs, int phase) {
+        StepEvent& event = events[written & (capacity - 1)];
+        event.deltaUs = deltaUs < 0xFFFF ? deltaUs : 0xFFFF;
+        uint32_t target = targetUs / 8;
+        event.phaseTarget = (phase << 13) | (target < 0x1FFF ? target : 0x1FFF);
+        written = written + 1;
+    }
+
+    // Copy the buffered events, oldest first, into `out` (room for
+    // getCapacity() events). Returns how many were copied.
+    uint16_t snapshot(StepEvent* out) {
+        noInterrupts();
+        uint32_t end = written;
+        uint16_t count = end < capacity ? end : capacity;
+        for (uint16_t i = 0; i < count; i++) {
+            out[i] = events[(end - count + i) & (capacity - 1)];
+        }
+        interrupts();
+        return count;
+    }
+
+    uint16_t getCapacity() {
+        return capacity;
+    }
+
+    uint32_t getWritten() {
+        return written;
+    }
+
+    static StepTraceStats analyze(const StepEvent* events, uint16_t count) {
+        StepTraceStats stats = {0, 0, 0, 0, 0};
+        double sum = 0;
+        double sumSquares = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            int32_t delta = events[i].deltaUs;
+            int32_t target = events[i].getTargetUs();
+            sum += delta;
+            sumSquares += (double)delta * delta;
+            if (i == 0 || delta - target > stats.maxOvershootUs) {
+                stats.maxOvershootUs = delta - target;
+            }
+            if (delta >= 2 * target) {
+                stats.missed++;
+            }
+        }
+        stats.count = count;
+        if (count > 0) {
+            double mean = sum / count;
+            double variance = sumSquares / count - mean * mean;
+            stats.meanUs = mean;
+            stats.stddevUs = variance > 0 ? sqrt(variance) : 0;
+        }
+        return stats;
+    }
+};
+
+#endif // STEP_TRACE_H
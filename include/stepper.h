@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "coil_output.h"
+#include "ramp_profile.h"
+#include "step_trace.h"
 
 // Direction enumeration
 enum Direction {
@@ -17,82 +20,276 @@ enum MotorState {
     MOTOR_RUNNING
 };
 
-// Half-step sequence for 28BYJ-48 (smoother operation)
-const int STEP_SEQUENCE[8][4] = {
-    {1, 0, 0, 0},
-    {1, 1, 0, 0},
-    {0, 1, 0, 0},
-    {0, 1, 1, 0},
-    {0, 0, 1, 0},
-    {0, 0, 1, 1},
-    {0, 0, 0, 1},
-    {1, 0, 0, 1}
+// What ends a rotation
+enum MotionMode {
+    MOTION_TIMED,       // Run for a duration
+    MOTION_STEPS        // Run an exact number of steps
+};
+
+// Coil drive sequence. Values are stored in settings.
+enum DriveMode {
+    DRIVE_HALF = 0,     // Alternating one and two coils - smoothest, finest steps
+    DRIVE_FULL = 1,     // Two coils - most torque, twice the rotation per step
+    DRIVE_WAVE = 2      // One coil - half the coil current, least torque
+};
+
+const char* const DRIVE_MODE_NAMES[] = {
+    "half", "full", "wave"
+};
+
+// Half-step sequence for 28BYJ-48, one nibble per phase from the low end
+// (bit n = coil IN(n+1)). Being a constant it is an immediate in code, not
+// a table in RAM. The odd phases on their own make full-step (two-phase)
+// drive, the even phases wave drive.
+constexpr uint32_t HALF_STEP_SEQUENCE = 0x98C46231;
+
+constexpr uint8_t phaseCoils(int phase) {
+    return (HALF_STEP_SEQUENCE >> (phase * 4)) & 0xF;
+}
+
+static_assert(phaseCoils(0) == 0x1 && phaseCoils(1) == 0x3 && phaseCoils(7) == 0x9,
+              "IN1, IN1+IN2, ... IN4+IN1");
+
+// Output masks of one motor for each half-step phase. Built by the compiler
+// when the pins are constants.
+struct PhaseMasks {
+    uint32_t coils;             // All four outputs
+    uint32_t phase[8];          // Outputs energized in each phase
+
+    static constexpr PhaseMasks forPins(int in1, int in2, int in3, int in4) {
+        PhaseMasks masks = {};
+        const int pins[4] = {in1, in2, in3, in4};
+        for (int i = 0; i < 4; i++) {
+            masks.coils |= CoilOutput::pinMask(pins[i]);
+        }
+        for (int p = 0; p < 8; p++) {
+            for (int i = 0; i < 4; i++) {
+                if (phaseCoils(p) & (1 << i)) {
+                    masks.phase[p] |= CoilOutput::pinMask(pins[i]);
+                }
+            }
+        }
+        return masks;
+    }
 };
 
 class Stepper {
 private:
-    int pins[4];
-    int currentStep;
+    PhaseMasks masks;
+    int currentStep;            // Phase, 0-7
     bool lastDirectionCW;  // For bidirectional mode
-    unsigned long stepDelay;
+    int rpm;
+    DriveMode driveMode;
+    int stride;                 // Phases per step in the current motion
 
-    // Non-blocking state
-    MotorState state;
+    // Non-blocking state - written by the step engine interrupt
+    volatile MotorState state;
     bool currentDirection;
-    unsigned long targetEndTime;
-    unsigned long lastStepTime;
-    int totalSteps;
+    unsigned long stepIntervalUs;  // Cruise interval
+    unsigned long usSinceStep;
+
+    // Ramp state - rampSteps/rampDownUs are derived from the cruise speed
+    int rampSteps;                 // Table entries slower than cruise
+    int rampStride;                // Table entries (half-steps) per step
+    unsigned long rampDownUs;      // Time needed to decelerate from cruise
+    int rampIndex;                 // Current position on the ramp
+    bool decelerating;
+    unsigned long currentIntervalUs;
+    MotionMode motionMode;
+    volatile unsigned long remainingUs;
+    volatile unsigned long remainingSteps;
+    volatile int totalSteps;
+    volatile uint32_t lateSteps;   // Steps issued over an interval past their deadline
+
+    // Optional step timing trace, null while off
+    StepTrace* volatile trace;
+    unsigned long usSinceLastStep;
+
+    // Hold current chopping
+    bool energized;                // Coils on right now
+    uint8_t chopTick;              // Position in the chop period
+    uint64_t runningUs;            // Time spent running, and with the coils on
+    uint64_t energizedUs;
 
 public:
-    Stepper(int in1, int in2, int in3, int in4) {
-        pins[0] = in1;
-        pins[1] = in2;
-        pins[2] = in3;
-        pins[3] = in4;
+    // Unwired - call setPins() before begin()
+    Stepper() {
+        masks = {};
         currentStep = 0;
         lastDirectionCW = true;
-        stepDelay = STEP_DELAY_MS;
+        rpm = DEFAULT_RPM;
+        driveMode = DRIVE_HALF;
+        stride = 1;
+        stepIntervalUs = rpmToIntervalUs(DEFAULT_RPM, HALF_STEPS_PER_REVOLUTION);
+        rampIndex = 0;
+        decelerating = false;
+        currentIntervalUs = RAMP_START_US;
+        computeRamp();
         state = MOTOR_IDLE;
         totalSteps = 0;
-        lastStepTime = 0;
-        targetEndTime = 0;
+        lateSteps = 0;
+        usSinceStep = 0;
+        motionMode = MOTION_TIMED;
+        remainingUs = 0;
+        remainingSteps = 0;
+        trace = nullptr;
+        usSinceLastStep = 0;
+        energized = false;
+        chopTick = 0;
+        runningUs = 0;
+        energizedUs = 0;
+    }
+
+    Stepper(int in1, int in2, int in3, int in4) : Stepper() {
+        setPins(in1, in2, in3, in4);
+    }
+
+    // Coil outputs IN1-IN4: GPIO numbers, or shift register outputs with
+    // the 74HC595 backend
+    void setPins(int in1, int in2, int in3, int in4) {
+        setMasks(PhaseMasks::forPins(in1, in2, in3, in4));
+    }
+
+    void setMasks(const PhaseMasks& phaseMasks) {
+        masks = phaseMasks;
     }
 
     void begin() {
-        for (int i = 0; i < 4; i++) {
-            pinMode(pins[i], OUTPUT);
-            digitalWrite(pins[i], LOW);
+        CoilOutput::begin(masks.coils);
+    }
+
+    // Step interval for an output shaft speed
+    static unsigned long rpmToIntervalUs(int rpm, unsigned long stepsPerRevolution) {
+        return 60000000UL / ((unsigned long)rpm * stepsPerRevolution);
+    }
+
+    // Set the cruise interval between steps in microseconds
+    void setSpeed(unsigned long intervalUs) {
+        if (intervalUs < STEP_TICK_US) intervalUs = STEP_TICK_US;
+        noInterrupts();
+        stepIntervalUs = intervalUs;
+        computeRamp();
+        if (rampIndex > rampSteps) rampIndex = rampSteps;
+        interrupts();
+    }
+
+    void setRpm(int newRpm) {
+        rpm = constrain(newRpm, MIN_RPM, MAX_RPM);
+        setSpeed(rpmToIntervalUs(rpm, getStepsPerRevolution()));
+    }
+
+    int getRpm() {
+        return rpm;
+    }
+
+    // The sequence is picked up by the next motion; the speed is kept in
+    // RPM, so the step interval follows right away
+    void setDriveMode(DriveMode mode) {
+        driveMode = mode;
+        setRpm(rpm);
+    }
+
+    DriveMode getDriveMode() {
+        return driveMode;
+    }
+
+    // Steps per output shaft turn in the configured drive mode
+    unsigned long getStepsPerRevolution() {
+        return driveMode == DRIVE_HALF ? HALF_STEPS_PER_REVOLUTION : STEPS_PER_REVOLUTION;
+    }
+
+    // Find how much of the ramp table is slower than cruise speed, and how
+    // long the matching deceleration takes. Done here so the interrupt
+    // never has to sum or divide. The table is in half-steps: a full or
+    // wave step covers two entries and lasts twice as long, so the shaft
+    // accelerates the same in every drive mode.
+    void computeRamp() {
+        rampStride = driveMode == DRIVE_HALF ? 1 : 2;
+        rampSteps = 0;
+        rampDownUs = 0;
+        while (rampSteps < RAMP_STEPS &&
+               (unsigned long)RAMP_TABLE.intervalUs[rampSteps] * rampStride > stepIntervalUs) {
+            rampDownUs += (unsigned long)RAMP_TABLE.intervalUs[rampSteps] * rampStride;
+            rampSteps += rampStride;
         }
     }
 
-    void setSpeed(unsigned long delayMs) {
-        stepDelay = delayMs;
+    // Interval for the current ramp position
+    unsigned long IRAM_ATTR rampInterval() {
+        return rampIndex < rampSteps ? (unsigned long)RAMP_TABLE.intervalUs[rampIndex] * rampStride
+                                     : stepIntervalUs;
     }
 
-    void stepMotor(bool clockwise) {
-        if (clockwise) {
-            currentStep--;
-            if (currentStep < 0) currentStep = 7;
-        } else {
-            currentStep++;
-            if (currentStep >= 8) currentStep = 0;
+    // Move along the ramp after each step: up while accelerating, back down
+    // the same table while decelerating
+    void IRAM_ATTR advanceRamp() {
+        if (decelerating) {
+            rampIndex = rampIndex > rampStride ? rampIndex - rampStride : 0;
+        } else if (rampIndex < rampSteps) {
+            rampIndex += rampStride;
         }
+        currentIntervalUs = rampInterval();
+    }
 
-        for (int i = 0; i < 4; i++) {
-            digitalWrite(pins[i], STEP_SEQUENCE[currentStep][i]);
+    // Advance one step and add the resulting pin changes to the frame
+    void IRAM_ATTR stepMotor(bool clockwise, CoilFrame& frame) {
+        currentStep = (currentStep + (clockwise ? -stride : stride)) & 7;
+
+        uint32_t phase = masks.phase[currentStep];
+        frame.set |= phase;
+        frame.clear |= masks.coils & ~phase;
+        energized = true;
+        chopTick = 0;
+    }
+
+    // Chop only between steps while cruising slowly - never on the ramps,
+    // where torque matters most
+    bool IRAM_ATTR holdChopping() {
+        return HOLD_DWELL_US > 0 && totalSteps > 0 && usSinceStep >= HOLD_DWELL_US &&
+               stepIntervalUs >= HOLD_CHOP_MIN_INTERVAL_US &&
+               rampIndex >= rampSteps && !decelerating;
+    }
+
+    // Switch the held phase on for HOLD_CHOP_ON of every HOLD_CHOP_PERIOD
+    // ticks. The first tick of a period is on, so the chop continues
+    // straight on from the dwell.
+    void IRAM_ATTR holdChop(CoilFrame& frame) {
+        bool on = chopTick < HOLD_CHOP_ON;
+        chopTick = chopTick + 1 < HOLD_CHOP_PERIOD ? chopTick + 1 : 0;
+        if (on == energized) {
+            return;
+        }
+        if (on) {
+            frame.set |= masks.phase[currentStep];
+        } else {
+            frame.clear |= masks.coils;
         }
+        energized = on;
     }
 
-    void stop() {
+    void IRAM_ATTR stop() {
+        // De-energize all coils to save power and reduce heat. The step
+        // engine writes the same outputs, so keep it out meanwhile.
+        noInterrupts();
         state = MOTOR_IDLE;
-        // De-energize all coils to save power and reduce heat
-        for (int i = 0; i < 4; i++) {
-            digitalWrite(pins[i], LOW);
-        }
+        energized = false;
+        CoilOutput::write({0, masks.coils});
+        interrupts();
     }
 
     // Start a non-blocking rotation for a duration
     void startRotation(int seconds, Direction dir) {
+        startMotion(MOTION_TIMED, (unsigned long)seconds * 1000000UL, 0, dir);
+    }
+
+    // Start a non-blocking rotation of an exact number of steps in the
+    // configured drive mode
+    void startSteps(unsigned long steps, Direction dir) {
+        startMotion(MOTION_STEPS, 0, steps, dir);
+    }
+
+    void startMotion(MotionMode mode, unsigned long durationUs,
+                     unsigned long steps, Direction dir) {
         if (dir == DIR_BIDIRECTIONAL) {
             currentDirection = !lastDirectionCW;
             lastDirectionCW = currentDirection;
@@ -100,35 +297,102 @@ public:
             currentDirection = (dir == DIR_CLOCKWISE);
         }
 
-        targetEndTime = millis() + (unsigned long)seconds * 1000;
-        lastStepTime = millis();
+        // Hand the command to the step engine atomically
+        noInterrupts();
+        // Full steps walk the odd (two-coil) phases, wave steps the even ones
+        stride = driveMode == DRIVE_HALF ? 1 : 2;
+        if (driveMode == DRIVE_FULL) {
+            currentStep |= 1;
+        } else if (driveMode == DRIVE_WAVE) {
+            currentStep &= ~1;
+        }
+        motionMode = mode;
+        remainingUs = durationUs;
+        remainingSteps = steps;
+        usSinceStep = 0;
+        usSinceLastStep = 0;
+        chopTick = 0;
+        rampIndex = 0;
+        decelerating = false;
+        currentIntervalUs = rampInterval();
         totalSteps = 0;
         state = MOTOR_RUNNING;
+        interrupts();
     }
 
-    // Call this from the main loop - non-blocking
-    // Returns true if motor is still running
-    bool update() {
+    // Called from the step engine timer interrupt with the microseconds
+    // elapsed since the previous tick. Pin changes are collected in the frame
+    // and written by the engine. Returns true on the tick a motion finishes.
+    // Keep this short and in IRAM - no Serial, no heap.
+    bool IRAM_ATTR tick(unsigned long elapsedUs, CoilFrame& frame) {
         if (state != MOTOR_RUNNING) {
             return false;
         }
 
-        unsigned long now = millis();
+        runningUs += elapsedUs;
+        if (energized) {
+            energizedUs += elapsedUs;
+        }
 
-        // Check if rotation time is complete
-        if (now >= targetEndTime) {
-            stop();
-            return false;
+        // Check if the rotation is complete, and start slowing down once
+        // only the deceleration is left
+        if (motionMode == MOTION_STEPS) {
+            if (remainingSteps == 0) {
+                state = MOTOR_IDLE;
+                energized = false;
+                frame.clear |= masks.coils;
+                return true;
+            }
+            if (!decelerating && remainingSteps * rampStride <= (unsigned long)rampIndex) {
+                decelerating = true;
+            }
+        } else {
+            if (remainingUs <= elapsedUs) {
+                state = MOTOR_IDLE;
+                energized = false;
+                frame.clear |= masks.coils;
+                return true;
+            }
+            remainingUs -= elapsedUs;
+            if (!decelerating && remainingUs <= rampDownUs) {
+                decelerating = true;
+            }
         }
 
-        // Check if it's time for the next step
-        if (now - lastStepTime >= stepDelay) {
-            stepMotor(currentDirection);
+        // Check if it's time for the next step. The remainder carries over,
+        // so the average rate is exact even though ticks are coarser.
+        usSinceStep += elapsedUs;
+        usSinceLastStep += elapsedUs;
+        if (usSinceStep >= currentIntervalUs) {
+            usSinceStep -= currentIntervalUs;
+            // Never queue up a burst of catch-up steps after a stall
+            if (usSinceStep >= currentIntervalUs) {
+                usSinceStep = 0;
+                lateSteps++;
+            }
+            stepMotor(currentDirection, frame);
+            if (trace) {
+                trace->record(usSinceLastStep, currentIntervalUs, currentStep);
+            }
+            usSinceLastStep = 0;
             totalSteps++;
-            lastStepTime = now;
+            if (motionMode == MOTION_STEPS) remainingSteps--;
+            advanceRamp();
+        } else if (holdChopping()) {
+            // Between steps at low speed - chop the hold current
+            holdChop(frame);
+        } else if (!energized && totalSteps > 0) {
+            // Chopping ended part way through an off period
+            frame.set |= masks.phase[currentStep];
+            energized = true;
         }
+        return false;
+    }
 
-        return true;
+    // Stepping happens in the step engine interrupt, so this no longer
+    // has to be called on time. Returns true if motor is still running.
+    bool update() {
+        return state == MOTOR_RUNNING;
     }
 
     // Check if motor is currently running
@@ -136,9 +400,42 @@ public:
         return state == MOTOR_RUNNING;
     }
 
+    // Get steps issued in current/last rotation
+    int getStepsCompleted() {
+        return totalSteps;
+    }
+
+    // The same in half-steps, whatever the drive mode
+    unsigned long getHalfStepsCompleted() {
+        return (unsigned long)totalSteps * stride;
+    }
+
+    // Start or stop recording steps into a trace. Pass null to stop; the
+    // trace can be freed once this returns.
+    void setTrace(StepTrace* stepTrace) {
+        noInterrupts();
+        trace = stepTrace;
+        interrupts();
+    }
+
+    // Get steps issued late since boot
+    uint32_t getLateSteps() {
+        return lateSteps;
+    }
+
+    // Share of running time the coils were energized since boot. 1.0 with
+    // hold chopping off, less the slower the motor runs.
+    float getEnergizedDuty() {
+        noInterrupts();
+        uint64_t running = runningUs;
+        uint64_t on = energizedUs;
+        interrupts();
+        return running ? (float)on / (float)running : 0;
+    }
+
     // Get turns completed in current/last rotation
     float getTurnsCompleted() {
-        return (float)totalSteps / (float)HALF_STEPS_PER_REVOLUTION;
+        return (float)getHalfStepsCompleted() / (float)HALF_STEPS_PER_REVOLUTION;
     }
 
     bool getLastDirection() {
@@ -0,0 +1,98 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "config.h"
+
+const int MINUTES_PER_DAY = 24 * 60;
+const long NO_DAY = -1;
+
+// Days since 1970-01-01 for a calendar date, so consecutive dates are
+// always one apart, including across new year
+inline long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = (unsigned)(year - era * 400);
+    unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (long)dayOfEra - 719468;
+}
+
+// Local date of a Unix time as a day number, as days are counted in
+// ClockReading and the history
+inline long localDay(time_t epoch) {
+    struct tm local;
+    localtime_r(&epoch, &local);
+    return daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+// A point in local time, as the scheduler sees it
+struct ClockReading {
+    bool synced;        // False until SNTP has set the time
+    long day;           // Local date as a day number
+    int minute;         // Minute of the day, 0-1439
+    int second;
+};
+
+// Local time of day from SNTP. Until the first sync, days are counted from
+// boot instead, so daily counters still roll over every 24 hours. Uptime is
+// kept in 64 bits, which carries it across the 49.7 day millis() wrap.
+class WallClock {
+private:
+    uint64_t uptimeMs;
+    uint32_t lastMillis;
+    time_t lastEpoch;
+    ClockReading cached;
+
+public:
+    WallClock() {
+        uptimeMs = 0;
+        lastMillis = 0;
+        lastEpoch = 0;
+        cached = {false, 0, 0, 0};
+    }
+
+    void begin() {
+#ifdef ARDUINO_ARCH_ESP8266
+        configTime(TIMEZONE, NTP_SERVER);
+#endif
+    }
+
+    bool isSynced() {
+        return time(nullptr) >= MIN_VALID_EPOCH;
+    }
+
+    uint64_t getUptimeMs() {
+        return uptimeMs;
+    }
+
+    // Call once per loop(). Only does the calendar maths once a second.
+    const ClockReading& read() {
+        uint32_t now = millis();
+        uptimeMs += (uint32_t)(now - lastMillis);
+        lastMillis = now;
+
+        time_t epoch = time(nullptr);
+        if (epoch >= MIN_VALID_EPOCH) {
+            if (epoch != lastEpoch || !cached.synced) {
+                lastEpoch = epoch;
+                struct tm local;
+                localtime_r(&epoch, &local);
+                cached.synced = true;
+                cached.day = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+                cached.minute = local.tm_hour * 60 + local.tm_min;
+                cached.second = local.tm_sec;
+            }
+        } else {
+            uint32_t seconds = (uint32_t)(uptimeMs / 1000);
+            cached.synced = false;
+            cached.day = seconds / 86400;
+            cached.minute = (seconds % 86400) / 60;
+            cached.second = seconds % 60;
+        }
+        return cached;
+    }
+};
+
+#endif // WALL_CLOCK_H
@@ -0,0 +1,228 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "config.h"
+
+enum WiFiState {
+    WIFI_STATE_AP,          // No credentials - setup portal only
+    WIFI_STATE_CONNECTING,  // Station connect attempt in progress
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF      // Waiting before the next attempt
+};
+
+const char* const WIFI_STATE_NAMES[] = {
+    "ap", "connecting", "connected", "backoff"
+};
+
+// Non-blocking WiFi bring-up and reconnect, polled from loop().
+// Station attempts are retried with exponential backoff. After
+// WIFI_MAX_FAILURES in a row the setup AP comes up alongside the station,
+// and it is taken down again as soon as the station rejoins.
+class WiFiManager {
+private:
+    String ssid;
+    String password;
+    WiFiState state;
+    bool apActive;
+    int failures;                   // Consecutive failed attempts
+    unsigned long attemptStart;
+    unsigned long backoffStart;
+    unsigned long backoffMs;
+    unsigned long disconnectedAt;
+    bool everConnected;
+
+    // Connection metrics (milliseconds)
+    uint32_t firstConnectMs;        // Boot to first connection
+    uint32_t reconnectCount;
+    uint32_t lastReconnectMs;       // Link loss to rejoin
+    uint32_t maxReconnectMs;
+    uint32_t failedAttempts;
+
+public:
+    WiFiManager() {
+        state = WIFI_STATE_AP;
+        apActive = false;
+        failures = 0;
+        attemptStart = 0;
+        backoffStart = 0;
+        backoffMs = 0;
+        disconnectedAt = 0;
+        everConnected = false;
+        firstConnectMs = 0;
+        reconnectCount = 0;
+        lastReconnectMs = 0;
+        maxReconnectMs = 0;
+        failedAttempts = 0;
+    }
+
+    // Start with the given credentials. An empty SSID goes straight to the
+    // setup AP. Can be called again when the credentials change.
+    void begin(const String& newSsid, const String& newPassword) {
+        ssid = newSsid;
+        password = newPassword;
+        failures = 0;
+
+        // Reconnects are handled here, not by the SDK
+        WiFi.persistent(false);
+        WiFi.setAutoReconnect(false);
+
+        if (ssid.length() == 0) {
+            startAP();
+            state = WIFI_STATE_AP;
+            return;
+        }
+
+        // Keep a running setup AP until the station is actually connected
+        WiFi.mode(apActive ? WIFI_AP_STA : WIFI_STA);
+        connect();
+    }
+
+    // Call from loop(). Returns true when the network mode changed (AP up or
+    // down, station connected or lost), so addresses and services can be
+    // refreshed.
+    bool update() {
+        switch (state) {
+            case WIFI_STATE_AP:
+                return false;
+
+            case WIFI_STATE_CONNECTING:
+                if (WiFi.status() == WL_CONNECTED) {
+                    onConnected();
+                    return true;
+                }
+                if (millis() - attemptStart >= WIFI_TIMEOUT) {
+                    return onAttemptFailed();
+                }
+                return false;
+
+            case WIFI_STATE_BACKOFF:
+                if (millis() - backoffStart >= backoffMs) {
+                    connect();
+                }
+                return false;
+
+            case WIFI_STATE_CONNECTED:
+                if (WiFi.status() != WL_CONNECTED) {
+                    Serial.println("WiFi connection lost, reconnecting");
+                    disconnectedAt = millis();
+                    failures = 0;
+                    connect();
+                    return true;
+                }
+                return false;
+        }
+        return false;
+    }
+
+    WiFiState getState() {
+        return state;
+    }
+
+    bool isConnected() {
+        return state == WIFI_STATE_CONNECTED;
+    }
+
+    bool isApActive() {
+        return apActive;
+    }
+
+    uint32_t getFirstConnectMs() {
+        return firstConnectMs;
+    }
+
+    uint32_t getReconnectCount() {
+        return reconnectCount;
+    }
+
+    uint32_t getLastReconnectMs() {
+        return lastReconnectMs;
+    }
+
+    uint32_t getMaxReconnectMs() {
+        return maxReconnectMs;
+    }
+
+    uint32_t getFailedAttempts() {
+        return failedAttempts;
+    }
+
+private:
+    void connect() {
+        Serial.printf("Connecting to WiFi: %s\n", ssid.c_str());
+        WiFi.begin(ssid.c_str(), password.c_str());
+        attemptStart = millis();
+        state = WIFI_STATE_CONNECTING;
+    }
+
+    void onConnected() {
+        uint32_t now = millis();
+        if (everConnected) {
+            lastReconnectMs = now - disconnectedAt;
+            if (lastReconnectMs > maxReconnectMs) {
+                maxReconnectMs = lastReconnectMs;
+            }
+            reconnectCount++;
+        } else {
+            firstConnectMs = now;
+            everConnected = true;
+        }
+
+        failures = 0;
+        state = WIFI_STATE_CONNECTED;
+        if (apActive) {
+            stopAP();
+        }
+        Serial.println("WiFi connected!");
+    }
+
+    // Returns true if the setup AP was started
+    bool onAttemptFailed() {
+        failures++;
+        failedAttempts++;
+        WiFi.disconnect();
+
+        bool changed = false;
+        if (!apActive && failures >= WIFI_MAX_FAILURES) {
+            Serial.println("WiFi connection failed, starting setup AP");
+            startAP();
+            changed = true;
+        }
+
+        // Attempts scan every channel and drag the AP along, so retry
+        // rarely while someone may be using the setup portal
+        if (apActive) {
+            backoffMs = WIFI_BACKOFF_MAX_MS;
+        } else {
+            int shift = failures - 1 < 16 ? failures - 1 : 16;
+            backoffMs = (unsigned long)WIFI_BACKOFF_MIN_MS << shift;
+            if (backoffMs > WIFI_BACKOFF_MAX_MS) {
+                backoffMs = WIFI_BACKOFF_MAX_MS;
+            }
+        }
+        backoffStart = millis();
+        state = WIFI_STATE_BACKOFF;
+        Serial.printf("WiFi attempt %d failed, retrying in %lu s\n", failures, backoffMs / 1000);
+        return changed;
+    }
+
+    void startAP() {
+        if (apActive) {
+            return;
+        }
+        WiFi.mode(ssid.length() > 0 ? WIFI_AP_STA : WIFI_AP);
+        WiFi.softAP(AP_SSID, AP_PASSWORD);
+        apActive = true;
+        Serial.printf("AP started: %s\n", AP_SSID);
+    }
+
+    void stopAP() {
+        WiFi.softAPdisconnect(true);
+        WiFi.mode(WIFI_STA);
+        apActive = false;
+        Serial.println("Setup AP stopped");
+    }
+};
+
+#endif // WIFI_MANAGER_H
@@ -0,0 +1,146 @@
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "config.h"
+
+struct ScanResult {
+    char ssid[33];
+    int32_t rssi;
+    bool secure;
+};
+
+// Background WiFi scan with cached results.
+// Scans run asynchronously and are polled from loop(), so the step engine
+// and web server keep running while the radio sweeps channels. Requests are
+// answered from the cache immediately; a stale cache triggers a refresh.
+class WiFiScanner {
+private:
+    ScanResult results[WIFI_SCAN_MAX_RESULTS];
+    int resultCount;
+    unsigned long lastScanTime;
+    bool hasResults;
+    bool scanning;
+    volatile bool refreshRequested;
+
+public:
+    WiFiScanner() {
+        resultCount = 0;
+        lastScanTime = 0;
+        hasResults = false;
+        scanning = false;
+        refreshRequested = false;
+    }
+
+    // Ask for fresh results. Safe to call from web handlers - the scan
+    // itself is started by the next update().
+    void requestRefresh() {
+        if (!hasResults || millis() - lastScanTime >= WIFI_SCAN_MAX_AGE_MS) {
+            refreshRequested = true;
+        }
+    }
+
+    // Call from loop()
+    void update() {
+        if (scanning) {
+            int n = WiFi.scanComplete();
+            if (n == WIFI_SCAN_RUNNING) {
+                return;
+            }
+            scanning = false;
+            if (n >= 0) {
+                storeResults(n);
+            }
+            WiFi.scanDelete();
+            return;
+        }
+
+        if (refreshRequested) {
+            refreshRequested = false;
+            WiFi.scanNetworks(true);
+            scanning = true;
+        }
+    }
+
+    bool isScanning() {
+        return scanning || refreshRequested;
+    }
+
+    bool hasCache() {
+        return hasResults;
+    }
+
+    // Milliseconds since the cached results were taken
+    unsigned long getAge() {
+        return millis() - lastScanTime;
+    }
+
+    int getCount() {
+        return resultCount;
+    }
+
+    const ScanResult& getResult(int i) {
+        return results[i];
+    }
+
+private:
+    // Keep the strongest WIFI_SCAN_MAX_RESULTS networks, strongest first,
+    // with one entry per SSID (mesh and multi-AP setups repeat them)
+    void storeResults(int n) {
+        resultCount = 0;
+        for (int i = 0; i < n; i++) {
+            String ssid = WiFi.SSID(i);
+            if (ssid.length() == 0) {
+                continue;  // Hidden network
+            }
+            int32_t rssi = WiFi.RSSI(i);
+
+            int existing = -1;
+            for (int j = 0; j < resultCount; j++) {
+                if (strcmp(results[j].ssid, ssid.c_str()) == 0) {
+                    existing = j;
+                    break;
+                }
+            }
+            if (existing >= 0) {
+                if (rssi <= results[existing].rssi) {
+                    continue;
+                }
+                removeAt(existing);
+            }
+
+            // Insertion point in the sorted list
+            int pos = resultCount;
+            while (pos > 0 && results[pos - 1].rssi < rssi) {
+                pos--;
+            }
+            if (pos >= WIFI_SCAN_MAX_RESULTS) {
+                continue;
+            }
+
+            int last = resultCount < WIFI_SCAN_MAX_RESULTS ? resultCount : WIFI_SCAN_MAX_RESULTS - 1;
+            for (int j = last; j > pos; j--) {
+                results[j] = results[j - 1];
+            }
+            strlcpy(results[pos].ssid, ssid.c_str(), sizeof(results[pos].ssid));
+            results[pos].rssi = rssi;
+            results[pos].secure = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+            if (resultCount < WIFI_SCAN_MAX_RESULTS) {
+                resultCount++;
+            }
+        }
+
+        lastScanTime = millis();
+        hasResults = true;
+    }
+
+    void removeAt(int index) {
+        for (int j = index; j < resultCount - 1; j++) {
+            results[j] = results[j + 1];
+        }
+        resultCount--;
+    }
+};
+
+#endif // WIFI_SCAN_H
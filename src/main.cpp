@@ -1,44 +1,193 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
+#include <ESPAsyncTCP.h>
+#include <ESPAsyncWebServer.h>
 #include <ESP8266mDNS.h>
 #include <DNSServer.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <memory>
 
 #include "config.h"
 #include "stepper.h"
+#include "step_engine.h"
 #include "scheduler.h"
+#include "metrics.h"
+#include "command_queue.h"
+#include "wifi_scan.h"
+#include "wifi_manager.h"
+#include "settings_store.h"
+#include "checkpoint.h"
+#include "idle_governor.h"
+#include "deadline_queue.h"
+#include "power_budget.h"
+#include "step_trace.h"
+#include "history_log.h"
 
 // Global objects
-ESP8266WebServer server(WEB_SERVER_PORT);
+AsyncWebServer server(WEB_SERVER_PORT);
+AsyncEventSource events("/api/events");
 DNSServer dnsServer;
 
-Stepper motor1(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4);
-Stepper motor2(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4);
-
-Scheduler scheduler1(&motor1, 1);
-Scheduler scheduler2(&motor2, 2);
+// Motor n in the API and logs is motors[n - 1], run by schedulers[n - 1].
+// Indexes match the step engine attach order.
+static_assert(MOTOR_COUNT <= STEP_ENGINE_MAX_MOTORS, "Too many motors for the step engine");
+Stepper motors[MOTOR_COUNT];
+Scheduler schedulers[MOTOR_COUNT];
+
+#if COIL_OUTPUT == COIL_OUTPUT_GPIO
+// Phase masks worked out at compile time from the pin assignments
+constexpr PhaseMasks MOTOR_MASKS[] = {
+    PhaseMasks::forPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4),
+    PhaseMasks::forPins(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4)
+};
+static_assert(MOTOR_COUNT <= 2, "Direct GPIO drive has pins for two motors");
+#endif
+
+// JSON keys of each motor in the aggregate status and settings
+const char* const MOTOR_KEYS[] = {
+    "motor1", "motor2", "motor3", "motor4", "motor5", "motor6", "motor7", "motor8"
+};
+static_assert(MOTOR_COUNT <= 8, "Add JSON keys for the extra motors");
+
+// Step timing traces, allocated only for motors being traced
+StepTrace stepTraces[MOTOR_COUNT];
+
+// Limits how many motors are energized at once on the shared supply
+PowerBudget powerBudget;
+
+// Completed cycles and daily totals, kept on flash
+HistoryLog history;
+
+// Next time each scheduler has work. Schedulers in a burst aren't queued -
+// the step engine flags them when the burst ends.
+DeadlineQueue<STEP_ENGINE_MAX_MOTORS> deadlines;
+
+WallClock wallClock;
+SettingsStore settingsStore;
+CheckpointStore checkpoints;
+WiFiManager wifiManager;
+WiFiScanner wifiScanner;
+
+IdleGovernor idleGovernor;
+
+LoopMetrics metrics;
+LatencyHistogram commandLatency;  // Microseconds from web handler to loop()
+RequestMetrics requestMetrics;
+
+// Web handlers run in the TCP stack's callbacks; anything that changes
+// motor or scheduler state is queued here and applied by loop()
+SpscQueue<Command, COMMAND_QUEUE_SIZE> commands;
+
+// JSON responses are serialized here instead of into a heap String. The
+// async server reads the body as the TCP window allows, after the handler
+// has returned, so a response keeps its slot until its request is gone.
+struct JsonSlot {
+    bool busy;
+    char body[512 + MOTOR_COUNT * 256];
+};
+JsonSlot jsonSlots[JSON_RESPONSE_SLOTS];
+uint32_t jsonSlotMisses = 0;    // Responses copied to the heap, every slot in use
+
+// Current IP as text, refreshed when the WiFi mode changes rather than
+// formatted on every status request
+char ipString[16] = "0.0.0.0";
+
+// Last status pushed to event subscribers, so only changes are sent
+struct MotorSnapshot {
+    bool valid;
+    bool running;
+    bool rotating;
+    int cycles;
+    int totalCycles;
+    float turns;
+    int targetTpd;
+};
+MotorSnapshot lastPushed[MOTOR_COUNT];
+
+// Device fields as last pushed. The browser counts uptime up itself, so
+// that is only resent to correct drift.
+struct DeviceSnapshot {
+    bool valid;
+    bool apMode;
+    char ip[16];
+    uint32_t uptime;
+};
+DeviceSnapshot lastPushedDevice;
+const uint32_t UPTIME_RESYNC_S = 60;
+unsigned long lastPushTime = 0;
+volatile bool fullSnapshotRequested = false;
+
+// Web interface files. The filesystem image holds gzipped copies plus
+// /etags.txt, both generated by tools/compress_assets.py. index.html links
+// to versioned style.css/app.js URLs, so those can be cached for good while
+// index.html itself is always revalidated.
+struct WebAsset {
+    const char* uri;
+    const char* path;
+    const char* contentType;
+    const char* cacheControl;
+    String etag;
+};
+
+WebAsset webAssets[] = {
+    {"/", "/index.html", "text/html", "no-cache", ""},
+    {"/style.css", "/style.css", "text/css", "public, max-age=31536000, immutable", ""},
+    {"/app.js", "/app.js", "application/javascript", "public, max-age=31536000, immutable", ""}
+};
+const int WEB_ASSET_COUNT = sizeof(webAssets) / sizeof(webAssets[0]);
 
 bool apMode = false;
+bool mdnsStarted = false;
+unsigned long firstStepMs = 0;  // Boot to the first motor step
 String storedSSID = "";
 String storedPassword = "";
 
 // Forward declarations
 void setupWiFi();
+void applyNetworkMode();
 void setupWebServer();
 void loadSettings();
 void saveSettings();
-void handleRoot();
-void handleGetStatus();
-void handleGetSettings();
-void handleSetSettings();
-void handleStart();
-void handleStop();
-void handleTestMotor();
-void handleWiFiScan();
-void handleWiFiConnect();
-void handleNotFound();
+void flushSettings();
+void restoreCheckpoint();
+void saveCheckpoint();
+unsigned long msUntilNextWork();
+bool anyMotorRunning();
+void runScheduler(int index, const ClockReading& clock);
+void rescheduleAll();
+bool loadLegacySettings();
+void buildSettingsRecord(SettingsRecord& record);
+void applySettingsRecord(SettingsRecord& record);
+void updateIpString();
+void processCommands();
+void applyMotorSettings(Scheduler& scheduler, const MotorSettings& s);
+int windowEndForHours(int hours);
+void loadAssetEtags();
+bool serveAsset(AsyncWebServerRequest* request, WebAsset& asset);
+void sendJsonBuffer(AsyncWebServerRequest* request, JsonDocument& doc);
+void collectBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                 size_t index, size_t total);
+bool queueCommand(const Command& cmd);
+void postCommand(AsyncWebServerRequest* request, const Command& cmd);
+void handleRoot(AsyncWebServerRequest* request);
+void handleGetStatus(AsyncWebServerRequest* request);
+void handleGetSettings(AsyncWebServerRequest* request);
+void handleSetSettings(AsyncWebServerRequest* request);
+void handleStart(AsyncWebServerRequest* request);
+void handleStop(AsyncWebServerRequest* request);
+void handleTestMotor(AsyncWebServerRequest* request);
+void handleMotors(AsyncWebServerRequest* request);
+void handleGetStepTrace(AsyncWebServerRequest* request);
+void handleSetStepTrace(AsyncWebServerRequest* request);
+void handleGetHistory(AsyncWebServerRequest* request);
+void setStepTrace(int index, int events);
+void handleWiFiScan(AsyncWebServerRequest* request);
+void handleWiFiConnect(AsyncWebServerRequest* request);
+void handleGetMetrics(AsyncWebServerRequest* request);
+void handleNotFound(AsyncWebServerRequest* request);
+void pushStatusEvents();
+void pushCycleEvent(int motor, Scheduler& scheduler);
 
 void setup() {
     Serial.begin(115200);
@@ -56,118 +205,234 @@ void setup() {
     }
 
     // Initialize motors
-    motor1.begin();
-    motor2.begin();
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER
+        // Four consecutive outputs on the shift register chain
+        motors[m].setPins(m * 4, m * 4 + 1, m * 4 + 2, m * 4 + 3);
+#else
+        motors[m].setMasks(MOTOR_MASKS[m]);
+#endif
+        motors[m].begin();
+        powerBudget.attach(m, &motors[m]);
+        schedulers[m].attach(&motors[m], m + 1, &powerBudget, &history);
+        StepEngine::attach(&motors[m]);
+    }
+    StepEngine::begin();
     Serial.println("Motors initialized");
 
-    // Load saved settings
+    // Load saved settings, then resume any schedulers that were running
+    // before a reset
+    history.begin();
     loadSettings();
+    restoreCheckpoint();
+    rescheduleAll();
 
-    // Setup WiFi
+    // Setup WiFi, and SNTP for the active windows
     setupWiFi();
+    wallClock.begin();
 
     // Setup web server
+    loadAssetEtags();
     setupWebServer();
+    idleGovernor.begin();
 
     Serial.println("\nSystem ready!");
 }
 
 void loop() {
+    metrics.beginLoop();
+
     // Handle DNS for captive portal
     if (apMode) {
         dnsServer.processNextRequest();
+        metrics.lap(STAGE_DNS);
     } else {
         MDNS.update();
+        metrics.lap(STAGE_MDNS);
     }
 
-    // Handle web requests
-    server.handleClient();
+    // Apply commands queued by the web handlers
+    processCommands();
+    if (settingsStore.isDue()) {
+        flushSettings();
+    }
+    if (history.isDue()) {
+        history.flush();
+    }
+    metrics.lap(STAGE_COMMANDS);
 
-    // Update motors directly (for test mode)
-    motor1.update();
-    motor2.update();
+    // Connection state machine and background network scan
+    if (wifiManager.update()) {
+        applyNetworkMode();
+    }
+    wifiScanner.update();
+    metrics.lap(STAGE_WIFI);
+
+    // Step engine fallback for targets without timer1 (no-op on ESP8266)
+    StepEngine::poll();
+
+    // Run only the schedulers that are due: their deadline has passed or
+    // the step engine reports their burst ended. Motors are stepped by the
+    // step engine.
+    const ClockReading& clock = wallClock.read();
+    uint32_t completed = StepEngine::takeCompleted();
+    while (completed) {
+        runScheduler(__builtin_ctz(completed), clock);
+        completed &= completed - 1;
+    }
+    unsigned int due;
+    for (int n = 0; n < MOTOR_COUNT && deadlines.popDue(millis(), due); n++) {
+        runScheduler(due, clock);
+    }
+    // Bursts queued for the power budget start as running ones end
+    for (int n = 0; n < MOTOR_COUNT && powerBudget.nextReady(due); n++) {
+        runScheduler(due, clock);
+    }
+    if (firstStepMs == 0 && anyMotorRunning()) {
+        firstStepMs = millis();
+    }
+    saveCheckpoint();
+    metrics.lap(STAGE_SCHEDULER);
 
-    // Update schedulers (non-blocking)
-    scheduler1.update();
-    scheduler2.update();
+    // Push status changes to live subscribers
+    pushStatusEvents();
 
-    yield();
+    metrics.endLoop();
+
+    // Sleep until something is due
+    idleGovernor.idle(msUntilNextWork(), anyMotorRunning(), apMode);
 }
 
-void setupWiFi() {
-    // Check if we have stored credentials
-    if (storedSSID.length() > 0) {
-        Serial.printf("Connecting to WiFi: %s\n", storedSSID.c_str());
+bool anyMotorRunning() {
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        if (motors[m].isRunning()) {
+            return true;
+        }
+    }
+    return false;
+}
 
-        WiFi.mode(WIFI_STA);
-        WiFi.begin(storedSSID.c_str(), storedPassword.c_str());
+void runScheduler(int index, const ClockReading& clock) {
+    Scheduler& scheduler = schedulers[index];
+    if (scheduler.update(clock)) {
+        pushCycleEvent(index + 1, scheduler);
+    }
 
-        unsigned long startAttempt = millis();
-        while (WiFi.status() != WL_CONNECTED && millis() - startAttempt < WIFI_TIMEOUT) {
-            delay(500);
-            Serial.print(".");
-        }
+    unsigned long ms = scheduler.msUntilNextWork();
+    if (ms == ULONG_MAX) {
+        deadlines.cancel(index);
+    } else {
+        deadlines.schedule(index, millis() + ms);
+    }
+}
+
+// Look at every scheduler on the next loop, after anything outside the
+// schedulers changed their state
+void rescheduleAll() {
+    for (int i = 0; i < MOTOR_COUNT; i++) {
+        deadlines.schedule(i, millis());
+    }
+}
+
+// Time until any part of loop() has work to do
+unsigned long msUntilNextWork() {
+    if (StepEngine::needsPolling() && anyMotorRunning()) {
+        return 0;
+    }
+
+    // The DNS server polls its socket, keep the captive portal responsive
+    unsigned long ms = apMode ? 10 : ULONG_MAX;
+    ms = min(ms, deadlines.msUntilNext(millis()));
+    ms = min(ms, checkpoints.msUntilDue());
+    ms = min(ms, settingsStore.msUntilDue());
+    ms = min(ms, history.msUntilDue());
+    if (events.count() > 0) {
+        unsigned long sincePush = millis() - lastPushTime;
+        ms = min(ms, sincePush >= SSE_PUSH_INTERVAL_MS ? 0 : SSE_PUSH_INTERVAL_MS - sincePush);
+    }
+    return ms;
+}
 
-        if (WiFi.status() == WL_CONNECTED) {
-            Serial.println("\nWiFi connected!");
-            Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
+void setupWiFi() {
+    // Connection happens in the background - motors and the web server
+    // don't wait for it
+    wifiManager.begin(storedSSID, storedPassword);
+    applyNetworkMode();
+}
 
+// Bring DNS, mDNS and the displayed address in line with the WiFi manager
+void applyNetworkMode() {
+    bool ap = wifiManager.isApActive();
+    if (ap && !apMode) {
+        // Start DNS server for captive portal
+        dnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
+    } else if (!ap && apMode) {
+        dnsServer.stop();
+    }
+    apMode = ap;
+
+    if (wifiManager.isConnected()) {
+        if (!mdnsStarted) {
             // Start mDNS responder
             if (MDNS.begin("watchwinder")) {
                 Serial.println("mDNS started: http://watchwinder.local");
                 MDNS.addService("http", "tcp", 80);
+                mdnsStarted = true;
             }
-
-            apMode = false;
-            return;
+        } else {
+            MDNS.notifyAPChange();
         }
-
-        Serial.println("\nWiFi connection failed");
     }
 
-    // Start Access Point for setup
-    Serial.println("Starting Access Point...");
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP(AP_SSID, AP_PASSWORD);
-
-    // Start DNS server for captive portal
-    dnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
+    updateIpString();
+    Serial.printf("IP address: %s%s\n", ipString, apMode ? " (setup AP)" : "");
+}
 
-    Serial.printf("AP started: %s\n", AP_SSID);
-    Serial.printf("AP IP address: %s\n", WiFi.softAPIP().toString().c_str());
-    apMode = true;
+void updateIpString() {
+    IPAddress ip = apMode ? WiFi.softAPIP() : WiFi.localIP();
+    snprintf(ipString, sizeof(ipString), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 }
 
 void setupWebServer() {
-    // API endpoints - register these FIRST
+    // API endpoints - register these FIRST. POST bodies are gathered by
+    // collectBody() before the handler runs.
     server.on("/", HTTP_GET, handleRoot);
     server.on("/api/status", HTTP_GET, handleGetStatus);
     server.on("/api/settings", HTTP_GET, handleGetSettings);
-    server.on("/api/settings", HTTP_POST, handleSetSettings);
-    server.on("/api/start", HTTP_POST, handleStart);
-    server.on("/api/stop", HTTP_POST, handleStop);
-    server.on("/api/test", HTTP_POST, handleTestMotor);
+    server.on("/api/settings", HTTP_POST, handleSetSettings, NULL, collectBody);
+    server.on("/api/start", HTTP_POST, handleStart, NULL, collectBody);
+    server.on("/api/stop", HTTP_POST, handleStop, NULL, collectBody);
+    server.on("/api/test", HTTP_POST, handleTestMotor, NULL, collectBody);
+    // Also matches every path below /api/motors/
+    server.on("/api/motors", HTTP_GET | HTTP_POST, handleMotors, NULL, collectBody);
     server.on("/api/wifi/scan", HTTP_GET, handleWiFiScan);
-    server.on("/api/wifi/connect", HTTP_POST, handleWiFiConnect);
+    server.on("/api/wifi/connect", HTTP_POST, handleWiFiConnect, NULL, collectBody);
+    server.on("/api/metrics", HTTP_GET, handleGetMetrics);
+    server.on("/api/diag/steptrace", HTTP_GET, handleGetStepTrace);
+    server.on("/api/diag/steptrace", HTTP_POST, handleSetStepTrace, NULL, collectBody);
+    server.on("/api/history", HTTP_GET, handleGetHistory);
+
+    // Live status stream - the first push to a new subscriber is a full snapshot
+    events.onConnect([](AsyncEventSourceClient* client) {
+        if (events.count() > SSE_MAX_CLIENTS) {
+            client->close();
+            return;
+        }
+        fullSnapshotRequested = true;
+        IdleGovernor::wake();
+    });
+    server.addHandler(&events);
 
     // Serve static files explicitly
-    server.on("/style.css", HTTP_GET, []() {
-        File file = LittleFS.open("/style.css", "r");
-        if (file) {
-            server.streamFile(file, "text/css");
-            file.close();
-        } else {
-            server.send(404, "text/plain", "Not found");
+    server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!serveAsset(request, webAssets[1])) {
+            request->send(404, "text/plain", "Not found");
         }
     });
 
-    server.on("/app.js", HTTP_GET, []() {
-        File file = LittleFS.open("/app.js", "r");
-        if (file) {
-            server.streamFile(file, "application/javascript");
-            file.close();
-        } else {
-            server.send(404, "text/plain", "Not found");
+    server.on("/app.js", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!serveAsset(request, webAssets[2])) {
+            request->send(404, "text/plain", "Not found");
         }
     });
 
@@ -178,13 +443,230 @@ void setupWebServer() {
     Serial.println("Web server started");
 }
 
-void handleRoot() {
-    File file = LittleFS.open("/index.html", "r");
-    if (file) {
-        server.streamFile(file, "text/html");
-        file.close();
+// Apply everything the web handlers queued since the last loop
+void processCommands() {
+    Command cmd;
+    bool settingsChanged = false;
+    bool anyCommand = false;
+
+    while (commands.pop(cmd)) {
+        commandLatency.record(micros() - cmd.receivedUs);
+        anyCommand = true;
+        switch (cmd.type) {
+            case CMD_START:
+                for (int m = 0; m < MOTOR_COUNT; m++) {
+                    if (cmd.motor == 0 || cmd.motor == m + 1) {
+                        schedulers[m].start();
+                        Serial.printf("Motor %d started\n", m + 1);
+                    }
+                }
+                break;
+
+            case CMD_STOP:
+                for (int m = 0; m < MOTOR_COUNT; m++) {
+                    if (cmd.motor == 0 || cmd.motor == m + 1) {
+                        schedulers[m].stop();
+                        Serial.printf("Motor %d stopped\n", m + 1);
+                    }
+                }
+                break;
+
+            case CMD_TEST:
+                Serial.printf("Testing motor %d, direction %d, duration %d sec\n",
+                              cmd.motor, cmd.direction, cmd.duration);
+                // Motor runs in the background on the step engine
+                if (cmd.motor < 1 || cmd.motor > MOTOR_COUNT) {
+                    break;
+                }
+                if (powerBudget.claim(cmd.motor - 1)) {
+                    motors[cmd.motor - 1].startRotation(cmd.duration, (Direction)cmd.direction);
+                } else {
+                    Serial.println("Test skipped, motor supply budget is in use");
+                }
+                break;
+
+            case CMD_SETTINGS:
+                if (cmd.motor >= 1 && cmd.motor <= MOTOR_COUNT) {
+                    applyMotorSettings(schedulers[cmd.motor - 1], cmd.settings);
+                    settingsChanged = true;
+                }
+                break;
+
+            case CMD_WIFI_CONNECT:
+                storedSSID = cmd.ssid;
+                storedPassword = cmd.password;
+                flushSettings();
+                Serial.println("WiFi credentials saved, connecting...");
+
+                // The setup AP stays up until the new network is joined
+                wifiManager.begin(storedSSID, storedPassword);
+                applyNetworkMode();
+                break;
+
+            case CMD_TRACE:
+                if (cmd.motor >= 1 && cmd.motor <= MOTOR_COUNT) {
+                    setStepTrace(cmd.motor - 1, cmd.traceEvents);
+                }
+                break;
+        }
+    }
+
+    if (settingsChanged) {
+        saveSettings();
+    }
+    if (anyCommand) {
+        rescheduleAll();
+    }
+}
+
+// Switch a motor's step trace off, or (re)start it with room for `events`
+void setStepTrace(int index, int events) {
+    motors[index].setTrace(nullptr);
+    stepTraces[index].end();
+    if (events <= 0) {
+        Serial.printf("Motor %d: Step trace off\n", index + 1);
+        return;
+    }
+    if (stepTraces[index].begin(min(events, STEP_TRACE_MAX_EVENTS))) {
+        motors[index].setTrace(&stepTraces[index]);
+        Serial.printf("Motor %d: Tracing %u steps\n", index + 1, stepTraces[index].getCapacity());
     } else {
-        server.send(200, "text/html",
+        Serial.printf("Motor %d: No memory for a step trace\n", index + 1);
+    }
+}
+
+// Window of the given length starting at the default start time
+int windowEndForHours(int hours) {
+    return (DEFAULT_WINDOW_START + hours * 60) % MINUTES_PER_DAY;
+}
+
+void applyMotorSettings(Scheduler& scheduler, const MotorSettings& s) {
+    scheduler.setSettings(s.enabled, s.direction, s.turnsPerDay, s.windowStart, s.windowEnd,
+                          s.rotationTime, s.restTime, s.rpm, s.driveMode);
+}
+
+// Settings fields from a JSON object. Fields it leaves out keep their
+// value in `current`, so a client can change just one.
+MotorSettings parseMotorSettings(JsonObject m, const MotorSettings& current) {
+    MotorSettings s = current;
+    s.enabled = m["enabled"] | current.enabled;
+    s.direction = (Direction)(m["direction"] | (int)current.direction);
+    s.turnsPerDay = m["tpd"] | current.turnsPerDay;
+    if (m.containsKey("windowStart") || !m.containsKey("activeHours")) {
+        s.windowStart = m["windowStart"] | current.windowStart;
+        s.windowEnd = m["windowEnd"] | current.windowEnd;
+    } else {
+        // Clients that only know about active hours
+        s.windowStart = DEFAULT_WINDOW_START;
+        s.windowEnd = windowEndForHours(m["activeHours"] | DEFAULT_ACTIVE_HOURS);
+    }
+    s.rotationTime = m["rotationTime"] | current.rotationTime;
+    s.restTime = m["restTime"] | current.restTime;
+    s.rpm = m["rpm"] | current.rpm;
+    s.driveMode = (DriveMode)(m["driveMode"] | (int)current.driveMode);
+    return s;
+}
+
+// Gather a POST body into request->_tempObject, which the server frees
+// along with the request
+void collectBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                 size_t index, size_t total) {
+    if (total > MAX_REQUEST_BODY) {
+        return;
+    }
+    if (index == 0) {
+        request->_tempObject = malloc(total + 1);
+    }
+    if (request->_tempObject == NULL) {
+        return;
+    }
+
+    char* body = (char*)request->_tempObject;
+    memcpy(body + index, data, len);
+    if (index + len == total) {
+        body[total] = '\0';
+    }
+}
+
+// Queue a command for loop() and answer straight away
+// Every command goes through here, so it is stamped for the latency
+// metrics and loop() wakes up to apply it
+bool queueCommand(const Command& cmd) {
+    Command queued = cmd;
+    queued.receivedUs = micros();
+    if (!commands.push(queued)) {
+        return false;
+    }
+    IdleGovernor::wake();
+    return true;
+}
+
+void postCommand(AsyncWebServerRequest* request, const Command& cmd) {
+    if (queueCommand(cmd)) {
+        request->send(200, "application/json", "{\"success\":true}");
+    } else {
+        request->send(503, "application/json", "{\"error\":\"Busy, try again\"}");
+    }
+}
+
+// Read the content hashes for the web assets once at boot
+void loadAssetEtags() {
+    File file = LittleFS.open("/etags.txt", "r");
+    if (!file) {
+        Serial.println("No asset ETags found, caching disabled");
+        return;
+    }
+
+    // One "<path> <hash>" per line
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        int space = line.indexOf(' ');
+        if (space < 0) continue;
+
+        String path = line.substring(0, space);
+        String hash = line.substring(space + 1);
+        hash.trim();
+
+        for (int i = 0; i < WEB_ASSET_COUNT; i++) {
+            if (path == webAssets[i].path) {
+                webAssets[i].etag = "\"" + hash + "\"";
+            }
+        }
+    }
+    file.close();
+}
+
+// Serve a web asset, preferring the gzipped copy. Returns false if missing.
+bool serveAsset(AsyncWebServerRequest* request, WebAsset& asset) {
+    // Unchanged since the browser's copy - no body needed
+    if (asset.etag.length() > 0 && request->hasHeader("If-None-Match") &&
+        request->getHeader("If-None-Match")->value() == asset.etag) {
+        AsyncWebServerResponse* response = request->beginResponse(304);
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", asset.cacheControl);
+        request->send(response);
+        return true;
+    }
+
+    String gzPath = String(asset.path) + ".gz";
+    if (!LittleFS.exists(gzPath) && !LittleFS.exists(asset.path)) {
+        return false;
+    }
+
+    // When only the .gz copy exists the file response serves it with
+    // Content-Encoding: gzip; a hand-built image falls back to the plain file
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, asset.path, asset.contentType);
+    if (asset.etag.length() > 0) {
+        response->addHeader("ETag", asset.etag);
+    }
+    response->addHeader("Cache-Control", asset.cacheControl);
+    request->send(response);
+    return true;
+}
+
+void handleRoot(AsyncWebServerRequest* request) {
+    if (!serveAsset(request, webAssets[0])) {
+        request->send(200, "text/html",
             "<!DOCTYPE html><html><head><title>Watch Winder</title></head>"
             "<body><h1>Watch Winder</h1>"
             "<p>Web interface files not found. Please upload the data folder.</p>"
@@ -192,242 +674,937 @@ void handleRoot() {
     }
 }
 
-void handleGetStatus() {
-    StaticJsonDocument<512> doc;
+// Serialize into a free slot and send straight from it, so the body is never
+// copied to the heap. Only the response object and its headers are. The
+// handlers and the disconnect callback all run in the TCP task, so the busy
+// flag needs no lock. With every slot still being sent, the response gets a
+// copy of its own instead.
+void sendJsonBuffer(AsyncWebServerRequest* request, JsonDocument& doc) {
+    for (int i = 0; i < JSON_RESPONSE_SLOTS; i++) {
+        JsonSlot& slot = jsonSlots[i];
+        if (slot.busy) {
+            continue;
+        }
+        size_t length = serializeJson(doc, slot.body, sizeof(slot.body));
+        slot.busy = true;
+        request->onDisconnect([&slot]() { slot.busy = false; });
+        request->send_P(200, "application/json", (const uint8_t*)slot.body, length);
+        return;
+    }
+
+    jsonSlotMisses++;
+    String body;
+    serializeJson(doc, body);
+    request->send(200, "application/json", body);
+}
+
+// Status fields of one motor (index from 0)
+void addMotorStatus(JsonObject m, int index) {
+    Scheduler& scheduler = schedulers[index];
+    bool running;
+    int cycles, totalCycles, targetTpd;
+    float turns;
+    scheduler.getStatus(running, cycles, totalCycles, turns, targetTpd);
+    m["running"] = running;
+    m["cycles"] = cycles;
+    m["totalCycles"] = totalCycles;
+    m["turns"] = turns;
+    m["targetTpd"] = targetTpd;
+    m["nextCycle"] = scheduler.getTimeUntilNextCycle();
+    m["queued"] = powerBudget.isWaiting(index);  // Due, waiting for the power budget
+}
+
+void addMotorSettings(JsonObject m, int index) {
+    MotorSettings s = schedulers[index].getSettings();
+    m["enabled"] = s.enabled;
+    m["direction"] = s.direction;
+    m["tpd"] = s.turnsPerDay;
+    m["windowStart"] = s.windowStart;
+    m["windowEnd"] = s.windowEnd;
+    m["activeHours"] = s.activeHours;
+    m["rotationTime"] = s.rotationTime;
+    m["restTime"] = s.restTime;
+    m["rpm"] = s.rpm;
+    m["driveMode"] = s.driveMode;
+    m["cyclesPerDay"] = s.cyclesPerDay;
+    m["turnsPerCycle"] = s.turnsPerCycle;
+    m["burstMs"] = s.burstMs;
+    m["tpdReachable"] = s.tpdReachable;
+}
+
+const size_t MOTOR_STATUS_SIZE = JSON_OBJECT_SIZE(7);
+const size_t MOTOR_SETTINGS_SIZE = JSON_OBJECT_SIZE(14);
+
+void handleGetStatus(AsyncWebServerRequest* request) {
+    HeapProbe probe;
+    // Static - the TCP callback stack is small
+    static StaticJsonDocument<JSON_OBJECT_SIZE(5 + MOTOR_COUNT) + MOTOR_COUNT * MOTOR_STATUS_SIZE> doc;
+    doc.clear();
 
     doc["apMode"] = apMode;
-    doc["ip"] = apMode ? WiFi.softAPIP().toString() : WiFi.localIP().toString();
-    doc["uptime"] = millis() / 1000;
-
-    // Motor 1 status
-    JsonObject m1 = doc.createNestedObject("motor1");
-    bool running1;
-    int cycles1, totalCycles1, targetTpd1;
-    float turns1;
-    scheduler1.getStatus(running1, cycles1, totalCycles1, turns1, targetTpd1);
-    m1["running"] = running1;
-    m1["cycles"] = cycles1;
-    m1["totalCycles"] = totalCycles1;
-    m1["turns"] = turns1;
-    m1["targetTpd"] = targetTpd1;
-    m1["nextCycle"] = scheduler1.getTimeUntilNextCycle();
-
-    // Motor 2 status
-    JsonObject m2 = doc.createNestedObject("motor2");
-    bool running2;
-    int cycles2, totalCycles2, targetTpd2;
-    float turns2;
-    scheduler2.getStatus(running2, cycles2, totalCycles2, turns2, targetTpd2);
-    m2["running"] = running2;
-    m2["cycles"] = cycles2;
-    m2["totalCycles"] = totalCycles2;
-    m2["turns"] = turns2;
-    m2["targetTpd"] = targetTpd2;
-    m2["nextCycle"] = scheduler2.getTimeUntilNextCycle();
+    doc["ip"] = (const char*)ipString;  // Stored by pointer, not copied
+    doc["uptime"] = (uint32_t)(wallClock.getUptimeMs() / 1000);
+    doc["clockSynced"] = wallClock.isSynced();
+    doc["motorCount"] = MOTOR_COUNT;
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
-}
-
-void handleGetSettings() {
-    StaticJsonDocument<512> doc;
-
-    MotorSettings s1 = scheduler1.getSettings();
-    JsonObject m1 = doc.createNestedObject("motor1");
-    m1["enabled"] = s1.enabled;
-    m1["direction"] = s1.direction;
-    m1["tpd"] = s1.turnsPerDay;
-    m1["activeHours"] = s1.activeHours;
-    m1["rotationTime"] = s1.rotationTime;
-    m1["restTime"] = s1.restTime;
-    m1["cyclesPerDay"] = s1.cyclesPerDay;
-    m1["turnsPerCycle"] = s1.turnsPerCycle;
-
-    MotorSettings s2 = scheduler2.getSettings();
-    JsonObject m2 = doc.createNestedObject("motor2");
-    m2["enabled"] = s2.enabled;
-    m2["direction"] = s2.direction;
-    m2["tpd"] = s2.turnsPerDay;
-    m2["activeHours"] = s2.activeHours;
-    m2["rotationTime"] = s2.rotationTime;
-    m2["restTime"] = s2.restTime;
-    m2["cyclesPerDay"] = s2.cyclesPerDay;
-    m2["turnsPerCycle"] = s2.turnsPerCycle;
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        addMotorStatus(doc.createNestedObject(MOTOR_KEYS[m]), m);
+    }
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    sendJsonBuffer(request, doc);
+    requestMetrics.record(REQ_STATUS, probe.peakUse());
 }
 
-void handleSetSettings() {
-    if (!server.hasArg("plain")) {
-        server.send(400, "application/json", "{\"error\":\"No body\"}");
+void handleGetSettings(AsyncWebServerRequest* request) {
+    HeapProbe probe;
+    static StaticJsonDocument<JSON_OBJECT_SIZE(1 + MOTOR_COUNT) + MOTOR_COUNT * MOTOR_SETTINGS_SIZE> doc;
+    doc.clear();
+
+    doc["motorCount"] = MOTOR_COUNT;
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        addMotorSettings(doc.createNestedObject(MOTOR_KEYS[m]), m);
+    }
+
+    sendJsonBuffer(request, doc);
+    requestMetrics.record(REQ_SETTINGS, probe.peakUse());
+}
+
+void handleSetSettings(AsyncWebServerRequest* request) {
+    const char* body = (const char*)request->_tempObject;
+    if (body == NULL) {
+        request->send(400, "application/json", "{\"error\":\"No body\"}");
         return;
     }
 
-    StaticJsonDocument<512> doc;
-    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+    static StaticJsonDocument<256 * MOTOR_COUNT> doc;
+    DeserializationError error = deserializeJson(doc, body);
 
     if (error) {
-        server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
         return;
     }
 
-    if (doc.containsKey("motor1")) {
-        JsonObject m1 = doc["motor1"];
-        scheduler1.setSettings(
-            m1["enabled"] | true,
-            m1["direction"] | 0,
-            m1["tpd"] | DEFAULT_TPD,
-            m1["activeHours"] | DEFAULT_ACTIVE_HOURS,
-            m1["rotationTime"] | DEFAULT_ROTATION_TIME,
-            m1["restTime"] | DEFAULT_REST_TIME
-        );
+    // Parse every motor before queuing any of them
+    static Command cmd[MOTOR_COUNT];
+    int count = 0;
+    for (int i = 0; i < MOTOR_COUNT; i++) {
+        if (doc.containsKey(MOTOR_KEYS[i])) {
+            cmd[count] = {};
+            cmd[count].type = CMD_SETTINGS;
+            cmd[count].motor = i + 1;
+            cmd[count].settings = parseMotorSettings(doc[MOTOR_KEYS[i]], schedulers[i].getSettings());
+            count++;
+        }
     }
 
-    if (doc.containsKey("motor2")) {
-        JsonObject m2 = doc["motor2"];
-        scheduler2.setSettings(
-            m2["enabled"] | true,
-            m2["direction"] | 0,
-            m2["tpd"] | DEFAULT_TPD,
-            m2["activeHours"] | DEFAULT_ACTIVE_HOURS,
-            m2["rotationTime"] | DEFAULT_ROTATION_TIME,
-            m2["restTime"] | DEFAULT_REST_TIME
-        );
+    // All or nothing - a 503 must not leave some motors updated
+    if (commands.freeSlots() < (unsigned int)count) {
+        request->send(503, "application/json", "{\"error\":\"Busy, try again\"}");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        queueCommand(cmd[i]);
     }
 
-    saveSettings();
-    server.send(200, "application/json", "{\"success\":true}");
+    request->send(200, "application/json", "{\"success\":true}");
 }
 
-void handleStart() {
+void handleStart(AsyncWebServerRequest* request) {
     StaticJsonDocument<64> doc;
-    if (server.hasArg("plain")) {
-        deserializeJson(doc, server.arg("plain"));
+    if (request->_tempObject != NULL) {
+        deserializeJson(doc, (const char*)request->_tempObject);
     }
 
-    int motor = doc["motor"] | 0;  // 0 = both, 1 = motor1, 2 = motor2
+    Command cmd = {};
+    cmd.type = CMD_START;
+    cmd.motor = doc["motor"] | 0;  // 0 = all, otherwise motor number
+    postCommand(request, cmd);
+}
 
-    if (motor == 0 || motor == 1) {
-        scheduler1.start();
-        Serial.println("Motor 1 started");
-    }
-    if (motor == 0 || motor == 2) {
-        scheduler2.start();
-        Serial.println("Motor 2 started");
+void handleStop(AsyncWebServerRequest* request) {
+    StaticJsonDocument<64> doc;
+    if (request->_tempObject != NULL) {
+        deserializeJson(doc, (const char*)request->_tempObject);
     }
 
-    server.send(200, "application/json", "{\"success\":true}");
+    Command cmd = {};
+    cmd.type = CMD_STOP;
+    cmd.motor = doc["motor"] | 0;  // 0 = all, otherwise motor number
+    postCommand(request, cmd);
 }
 
-void handleStop() {
+void handleTestMotor(AsyncWebServerRequest* request) {
     StaticJsonDocument<64> doc;
-    if (server.hasArg("plain")) {
-        deserializeJson(doc, server.arg("plain"));
+    if (request->_tempObject == NULL) {
+        request->send(400, "application/json", "{\"error\":\"No body\"}");
+        return;
+    }
+
+    deserializeJson(doc, (const char*)request->_tempObject);
+
+    Command cmd = {};
+    cmd.type = CMD_TEST;
+    cmd.motor = doc["motor"] | 1;
+    cmd.direction = doc["direction"] | 0;
+    cmd.duration = doc["duration"] | 3;  // seconds
+
+    // Send response immediately - motor runs in background
+    postCommand(request, cmd);
+}
+
+// Per-motor API, n = 1..MOTOR_COUNT:
+//   GET  /api/motors               status of every motor
+//   GET  /api/motors/n             status and settings of motor n
+//   POST /api/motors/n             change the settings given (fields as in /api/settings)
+//   POST /api/motors/n/start       also stop, and test with {direction, duration}
+void handleMotors(AsyncWebServerRequest* request) {
+    const String& url = request->url();
+    const char* path = url.c_str() + strlen("/api/motors");
+    if (*path == '/') {
+        path++;
     }
+    bool post = request->method() == HTTP_POST;
 
-    int motor = doc["motor"] | 0;  // 0 = both, 1 = motor1, 2 = motor2
+    if (*path == '\0') {
+        if (post) {
+            request->send(405, "application/json", "{\"error\":\"Method not allowed\"}");
+            return;
+        }
+        static StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(MOTOR_COUNT) +
+                                  MOTOR_COUNT * JSON_OBJECT_SIZE(8)> doc;
+        doc.clear();
+        JsonArray list = doc.createNestedArray("motors");
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            JsonObject motor = list.createNestedObject();
+            motor["id"] = m + 1;
+            addMotorStatus(motor, m);
+        }
+        sendJsonBuffer(request, doc);
+        return;
+    }
 
-    if (motor == 0 || motor == 1) {
-        scheduler1.stop();
-        Serial.println("Motor 1 stopped");
+    char* end;
+    long id = strtol(path, &end, 10);
+    if (end == path || id < 1 || id > MOTOR_COUNT || (*end != '\0' && *end != '/')) {
+        request->send(404, "application/json", "{\"error\":\"No such motor\"}");
+        return;
     }
-    if (motor == 0 || motor == 2) {
-        scheduler2.stop();
-        Serial.println("Motor 2 stopped");
+    const char* action = *end == '/' ? end + 1 : "";
+
+    if (*action == '\0' && !post) {
+        static StaticJsonDocument<JSON_OBJECT_SIZE(3) + MOTOR_STATUS_SIZE + MOTOR_SETTINGS_SIZE> doc;
+        doc.clear();
+        doc["id"] = id;
+        addMotorStatus(doc.createNestedObject("status"), id - 1);
+        addMotorSettings(doc.createNestedObject("settings"), id - 1);
+        sendJsonBuffer(request, doc);
+        return;
+    }
+    if (!post) {
+        request->send(405, "application/json", "{\"error\":\"Method not allowed\"}");
+        return;
     }
 
-    server.send(200, "application/json", "{\"success\":true}");
+    StaticJsonDocument<384> doc;
+    const char* body = (const char*)request->_tempObject;
+    if (body != NULL && deserializeJson(doc, body)) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
+
+    Command cmd = {};
+    cmd.motor = id;
+    if (*action == '\0') {
+        if (body == NULL) {
+            request->send(400, "application/json", "{\"error\":\"No body\"}");
+            return;
+        }
+        cmd.type = CMD_SETTINGS;
+        cmd.settings = parseMotorSettings(doc.as<JsonObject>(), schedulers[id - 1].getSettings());
+    } else if (strcmp(action, "start") == 0) {
+        cmd.type = CMD_START;
+    } else if (strcmp(action, "stop") == 0) {
+        cmd.type = CMD_STOP;
+    } else if (strcmp(action, "test") == 0) {
+        cmd.type = CMD_TEST;
+        cmd.direction = doc["direction"] | 0;
+        cmd.duration = doc["duration"] | 3;  // seconds
+    } else {
+        request->send(404, "application/json", "{\"error\":\"Unknown action\"}");
+        return;
+    }
+    postCommand(request, cmd);
 }
 
-void handleTestMotor() {
-    StaticJsonDocument<64> doc;
-    if (!server.hasArg("plain")) {
-        server.send(400, "application/json", "{\"error\":\"No body\"}");
+void handleWiFiScan(AsyncWebServerRequest* request) {
+    // Answer from the cache straight away; loop() refreshes it in the
+    // background if it is missing or stale
+    wifiScanner.requestRefresh();
+    IdleGovernor::wake();
+
+    static StaticJsonDocument<768> doc;
+    doc.clear();
+    doc["scanning"] = wifiScanner.isScanning();
+    if (wifiScanner.hasCache()) {
+        doc["age"] = wifiScanner.getAge() / 1000;
+    }
+    JsonArray networks = doc.createNestedArray("networks");
+
+    for (int i = 0; i < wifiScanner.getCount(); i++) {
+        const ScanResult& result = wifiScanner.getResult(i);
+        JsonObject network = networks.createNestedObject();
+        network["ssid"] = (const char*)result.ssid;
+        network["rssi"] = result.rssi;
+        network["secure"] = result.secure;
+    }
+
+    sendJsonBuffer(request, doc);
+}
+
+void handleWiFiConnect(AsyncWebServerRequest* request) {
+    const char* body = (const char*)request->_tempObject;
+    if (body == NULL) {
+        request->send(400, "application/json", "{\"error\":\"No body\"}");
         return;
     }
 
-    deserializeJson(doc, server.arg("plain"));
+    StaticJsonDocument<256> doc;
+    DeserializationError error = deserializeJson(doc, body);
 
-    int motor = doc["motor"] | 1;
-    int direction = doc["direction"] | 0;
-    int duration = doc["duration"] | 3;  // seconds
+    if (error) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
 
-    Serial.printf("Testing motor %d, direction %d, duration %d sec\n",
-                  motor, direction, duration);
+    Command cmd = {};
+    cmd.type = CMD_WIFI_CONNECT;
+    cmd.motor = 0;
+    strlcpy(cmd.ssid, doc["ssid"] | "", sizeof(cmd.ssid));
+    strlcpy(cmd.password, doc["password"] | "", sizeof(cmd.password));
 
-    // Start motor rotation (non-blocking) - motor will run in main loop
-    if (motor == 1) {
-        motor1.startRotation(duration, (Direction)direction);
-    } else if (motor == 2) {
-        motor2.startRotation(duration, (Direction)direction);
+    if (!queueCommand(cmd)) {
+        request->send(503, "application/json", "{\"error\":\"Busy, try again\"}");
+        return;
     }
 
-    // Send response immediately - motor runs in background
-    server.send(200, "application/json", "{\"success\":true}");
+    request->send(200, "application/json",
+        "{\"success\":true,\"message\":\"Credentials saved. Joining the network...\"}");
 }
 
-void handleWiFiScan() {
-    int n = WiFi.scanNetworks();
+// Add the fields of one motor that changed since the last push
+bool addMotorDelta(JsonObject parent, const char* key, Scheduler& scheduler,
+                   MotorSnapshot& last) {
+    MotorSnapshot now;
+    now.valid = true;
+    scheduler.getStatus(now.running, now.cycles, now.totalCycles, now.turns, now.targetTpd);
+    now.rotating = scheduler.isMotorActive();
+
+    bool full = !last.valid;
+    if (!full && now.running == last.running && now.rotating == last.rotating &&
+        now.cycles == last.cycles && now.totalCycles == last.totalCycles &&
+        now.turns == last.turns && now.targetTpd == last.targetTpd) {
+        return false;
+    }
 
-    StaticJsonDocument<1024> doc;
-    JsonArray networks = doc.createNestedArray("networks");
+    JsonObject m = parent.createNestedObject(key);
+    if (full || now.running != last.running) m["running"] = now.running;
+    if (full || now.cycles != last.cycles) m["cycles"] = now.cycles;
+    if (full || now.totalCycles != last.totalCycles) m["totalCycles"] = now.totalCycles;
+    if (full || now.turns != last.turns) m["turns"] = now.turns;
+    if (full || now.targetTpd != last.targetTpd) m["targetTpd"] = now.targetTpd;
 
-    for (int i = 0; i < n && i < 10; i++) {
-        JsonObject network = networks.createNestedObject();
-        network["ssid"] = WiFi.SSID(i);
-        network["rssi"] = WiFi.RSSI(i);
-        network["secure"] = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+    // The browser counts nextCycle down itself; it only needs resyncing
+    // when the schedule moves
+    m["nextCycle"] = scheduler.getTimeUntilNextCycle();
+
+    last = now;
+    return true;
+}
+
+// Add the device fields that changed since the last push
+bool addDeviceDelta(JsonObject root, DeviceSnapshot& last) {
+    uint32_t uptime = (uint32_t)(wallClock.getUptimeMs() / 1000);
+    bool full = !last.valid;
+    bool changed = false;
+
+    if (full || apMode != last.apMode) {
+        root["apMode"] = apMode;
+        last.apMode = apMode;
+        changed = true;
+    }
+    if (full || strcmp(ipString, last.ip) != 0) {
+        root["ip"] = (const char*)ipString;
+        strlcpy(last.ip, ipString, sizeof(last.ip));
+        changed = true;
+    }
+    if (full || uptime < last.uptime || uptime - last.uptime >= UPTIME_RESYNC_S) {
+        root["uptime"] = uptime;
+        last.uptime = uptime;
+        changed = true;
+    }
+
+    last.valid = true;
+    return changed;
+}
+
+void pushStatusEvents() {
+    if (millis() - lastPushTime < SSE_PUSH_INTERVAL_MS || events.count() == 0) {
+        return;
+    }
+    lastPushTime = millis();
+
+    // Resend everything so a new subscriber starts from a full snapshot
+    if (fullSnapshotRequested) {
+        fullSnapshotRequested = false;
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            lastPushed[m].valid = false;
+        }
+        lastPushedDevice.valid = false;
+    }
+
+    static StaticJsonDocument<JSON_OBJECT_SIZE(3 + MOTOR_COUNT) + MOTOR_COUNT * MOTOR_STATUS_SIZE> doc;
+    JsonObject root = doc.to<JsonObject>();
+    bool changed = addDeviceDelta(root, lastPushedDevice);
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        changed |= addMotorDelta(root, MOTOR_KEYS[m], schedulers[m], lastPushed[m]);
+    }
+    if (!changed) {
+        return;
+    }
+
+    static char buffer[128 + MOTOR_COUNT * 128];
+    serializeJson(doc, buffer, sizeof(buffer));
+    events.send(buffer, "status", millis());
+}
+
+void pushCycleEvent(int motor, Scheduler& scheduler) {
+    if (events.count() == 0) {
+        return;
+    }
+
+    char buffer[96];
+    snprintf(buffer, sizeof(buffer), "{\"motor\":%d,\"cycles\":%d,\"turns\":%.2f}",
+             motor, scheduler.getCompletedCycles(), scheduler.getTotalTurns());
+    events.send(buffer, "cycle", millis());
+}
+
+// Loop timing and step lateness. JSON by default, Prometheus text
+// exposition format with ?format=prometheus
+void handleGetMetrics(AsyncWebServerRequest* request) {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+
+    if (request->hasParam("format") && request->getParam("format")->value() == "prometheus") {
+        String out;
+        out.reserve(2048);
+        out += "# TYPE watchwinder_cpu_mhz gauge\n";
+        out += "watchwinder_cpu_mhz " + String(mhz) + "\n";
+        out += "# TYPE watchwinder_loop_stage_cycles histogram\n";
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            LatencyHistogram& h = metrics.getStage((LoopStage)s);
+            String label = String("stage=\"") + LOOP_STAGE_NAMES[s] + "\"";
+            uint32_t cumulative = 0;
+            for (int i = 0; i <= h.getHighestBucket(); i++) {
+                cumulative += h.getBucket(i);
+                out += "watchwinder_loop_stage_cycles_bucket{" + label + ",le=\"" +
+                       String((uint32_t)((2ULL << i) - 1)) + "\"} " + String(cumulative) + "\n";
+            }
+            out += "watchwinder_loop_stage_cycles_bucket{" + label + ",le=\"+Inf\"} " +
+                   String(h.getCount()) + "\n";
+            out += "watchwinder_loop_stage_cycles_sum{" + label + "} " + String(h.getSum()) + "\n";
+            out += "watchwinder_loop_stage_cycles_count{" + label + "} " + String(h.getCount()) + "\n";
+            out += "watchwinder_loop_stage_max_cycles{" + label + "} " + String(h.getMax()) + "\n";
+        }
+        out += "# TYPE watchwinder_request_heap_peak_bytes gauge\n";
+        for (int r = 0; r < REQ_COUNT; r++) {
+            out += "watchwinder_request_heap_peak_bytes{request=\"" + String(REQUEST_KIND_NAMES[r]) +
+                   "\"} " + String(requestMetrics.get((RequestKind)r).maxPeak) + "\n";
+        }
+        out += "# TYPE watchwinder_json_slot_misses_total counter\n";
+        out += "watchwinder_json_slot_misses_total " + String(jsonSlotMisses) + "\n";
+        out += "# TYPE watchwinder_late_steps_total counter\n";
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            out += "watchwinder_late_steps_total{motor=\"" + String(m + 1) + "\"} " +
+                   String(motors[m].getLateSteps()) + "\n";
+        }
+        out += "# TYPE watchwinder_coil_duty_ratio gauge\n";
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            out += "watchwinder_coil_duty_ratio{motor=\"" + String(m + 1) + "\"} " +
+                   String(motors[m].getEnergizedDuty(), 3) + "\n";
+        }
+        out += "# TYPE watchwinder_settings_writes_total counter\n";
+        out += "watchwinder_settings_writes_total " + String(settingsStore.getWrites()) + "\n";
+        out += "# TYPE watchwinder_settings_skipped_writes_total counter\n";
+        out += "watchwinder_settings_skipped_writes_total " + String(settingsStore.getSkippedWrites()) + "\n";
+        out += "# TYPE watchwinder_settings_last_write_us gauge\n";
+        out += "watchwinder_settings_last_write_us " + String(settingsStore.getLastWriteUs()) + "\n";
+        out += "# TYPE watchwinder_power_state_ms counter\n";
+        for (int p = 0; p < POWER_STATE_COUNT; p++) {
+            out += "watchwinder_power_state_ms{state=\"" + String(POWER_STATE_NAMES[p]) + "\"} " +
+                   String((uint32_t)(idleGovernor.getStateUs((PowerState)p) / 1000)) + "\n";
+        }
+        out += "# TYPE watchwinder_motor_current_ma gauge\n";
+        out += "watchwinder_motor_current_ma{stat=\"now\"} " + String(powerBudget.energizedMa()) + "\n";
+        out += "watchwinder_motor_current_ma{stat=\"peak\"} " + String(powerBudget.getPeakMa()) + "\n";
+        out += "watchwinder_motor_current_ma{stat=\"budget\"} " + String(MOTOR_BUDGET_MA) + "\n";
+        out += "# TYPE watchwinder_deferred_bursts_total counter\n";
+        out += "watchwinder_deferred_bursts_total " + String(powerBudget.getDeferred()) + "\n";
+        out += "# TYPE watchwinder_burst_max_wait_ms gauge\n";
+        out += "watchwinder_burst_max_wait_ms " + String(powerBudget.getMaxWaitMs()) + "\n";
+        out += "# TYPE watchwinder_avg_current_ma gauge\n";
+        out += "watchwinder_avg_current_ma " + String(idleGovernor.getAverageCurrentMa(), 1) + "\n";
+        out += "# TYPE watchwinder_command_latency_us gauge\n";
+        out += "watchwinder_command_latency_us{quantile=\"0.5\"} " + String(commandLatency.percentile(50)) + "\n";
+        out += "watchwinder_command_latency_us{quantile=\"0.99\"} " + String(commandLatency.percentile(99)) + "\n";
+        out += "watchwinder_command_latency_us{quantile=\"1\"} " + String(commandLatency.getMax()) + "\n";
+        out += "# TYPE watchwinder_first_step_ms gauge\n";
+        out += "watchwinder_first_step_ms " + String(firstStepMs) + "\n";
+        out += "# TYPE watchwinder_wifi_connect_ms gauge\n";
+        out += "watchwinder_wifi_connect_ms " + String(wifiManager.getFirstConnectMs()) + "\n";
+        out += "# TYPE watchwinder_wifi_reconnects_total counter\n";
+        out += "watchwinder_wifi_reconnects_total " + String(wifiManager.getReconnectCount()) + "\n";
+        out += "# TYPE watchwinder_wifi_reconnect_ms gauge\n";
+        out += "watchwinder_wifi_reconnect_ms{stat=\"last\"} " + String(wifiManager.getLastReconnectMs()) + "\n";
+        out += "watchwinder_wifi_reconnect_ms{stat=\"max\"} " + String(wifiManager.getMaxReconnectMs()) + "\n";
+        out += "# TYPE watchwinder_wifi_failed_attempts_total counter\n";
+        out += "watchwinder_wifi_failed_attempts_total " + String(wifiManager.getFailedAttempts()) + "\n";
+        request->send(200, "text/plain; version=0.0.4", out);
+        return;
+    }
+
+    DynamicJsonDocument doc(4096);
+    doc["cpuMHz"] = mhz;
+
+    JsonObject stages = doc.createNestedObject("stages");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        LatencyHistogram& h = metrics.getStage((LoopStage)s);
+        JsonObject stage = stages.createNestedObject(LOOP_STAGE_NAMES[s]);
+        stage["count"] = h.getCount();
+        stage["p99Us"] = h.percentile(99) / mhz;
+        stage["maxUs"] = h.getMax() / mhz;
+
+        // Bucket i holds samples below 2^(i+1) cycles
+        JsonArray buckets = stage.createNestedArray("buckets");
+        for (int i = 0; i <= h.getHighestBucket(); i++) {
+            buckets.add(h.getBucket(i));
+        }
+    }
+
+    JsonObject heap = doc.createNestedObject("requestHeap");
+    for (int r = 0; r < REQ_COUNT; r++) {
+        RequestHeapStats& stats = requestMetrics.get((RequestKind)r);
+        JsonObject req = heap.createNestedObject(REQUEST_KIND_NAMES[r]);
+        req["count"] = stats.count;
+        req["lastPeakBytes"] = stats.lastPeak;
+        req["maxPeakBytes"] = stats.maxPeak;
+    }
+    doc["jsonSlotMisses"] = jsonSlotMisses;   // Bodies copied, every slot busy
+    doc["freeHeap"] = ESP.getFreeHeap();
+    doc["firstStepMs"] = firstStepMs;
+
+    JsonObject settings = doc.createNestedObject("settingsStore");
+    settings["writes"] = settingsStore.getWrites();
+    settings["skippedWrites"] = settingsStore.getSkippedWrites();
+    settings["lastWriteUs"] = settingsStore.getLastWriteUs();
+    settings["pending"] = settingsStore.isDirty();
+    doc["checkpointFlashWrites"] = checkpoints.getFlashWrites();
+
+    JsonObject historyLog = doc.createNestedObject("history");
+    historyLog["cycles"] = history.getAppended();
+    historyLog["flushes"] = history.getFlushes();
+    historyLog["dropped"] = history.getDropped();
+
+    JsonObject power = doc.createNestedObject("power");
+    power["idleMode"] = IDLE_MODE_NAMES[idleGovernor.getMode()];
+    power["avgCurrentMa"] = idleGovernor.getAverageCurrentMa();  // Estimate, ESP8266 only
+    JsonObject powerStates = power.createNestedObject("stateMs");
+    for (int p = 0; p < POWER_STATE_COUNT; p++) {
+        powerStates[POWER_STATE_NAMES[p]] = (uint32_t)(idleGovernor.getStateUs((PowerState)p) / 1000);
+    }
+    JsonObject motorSupply = power.createNestedObject("motorSupply");
+    motorSupply["budgetMa"] = MOTOR_BUDGET_MA;
+    motorSupply["energizedMa"] = powerBudget.energizedMa();
+    motorSupply["peakMa"] = powerBudget.getPeakMa();
+    motorSupply["queued"] = powerBudget.getWaitingCount();
+    motorSupply["deferredBursts"] = powerBudget.getDeferred();
+    motorSupply["maxWaitMs"] = powerBudget.getMaxWaitMs();
+    JsonObject latency = power.createNestedObject("commandLatency");
+    latency["count"] = commandLatency.getCount();
+    latency["p50Us"] = commandLatency.percentile(50);
+    latency["p99Us"] = commandLatency.percentile(99);
+    latency["maxUs"] = commandLatency.getMax();
+
+    JsonObject wifi = doc.createNestedObject("wifi");
+    wifi["state"] = WIFI_STATE_NAMES[wifiManager.getState()];
+    wifi["connectMs"] = wifiManager.getFirstConnectMs();
+    wifi["reconnects"] = wifiManager.getReconnectCount();
+    wifi["lastReconnectMs"] = wifiManager.getLastReconnectMs();
+    wifi["maxReconnectMs"] = wifiManager.getMaxReconnectMs();
+    wifi["failedAttempts"] = wifiManager.getFailedAttempts();
+
+    JsonArray late = doc.createNestedArray("lateSteps");
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        late.add(motors[m].getLateSteps());
+    }
+    JsonArray duty = doc.createNestedArray("coilDuty");  // Energized share of running time
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        duty.add(motors[m].getEnergizedDuty());
     }
 
     String response;
     serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    request->send(200, "application/json", response);
 }
 
-void handleWiFiConnect() {
-    if (!server.hasArg("plain")) {
-        server.send(400, "application/json", "{\"error\":\"No body\"}");
+// A step trace copied out of its ring, streamed as CSV. Shared with the
+// response's fill callback, so it is freed with the response even if the
+// client goes away mid-stream.
+struct StepTraceExport {
+    StepEvent* events;
+    uint16_t count;
+    uint16_t next;
+    bool headerSent;
+
+    ~StepTraceExport() {
+        free(events);
+    }
+};
+
+// Step timing diagnostics:
+//   GET /api/diag/steptrace             summary statistics of every motor
+//   GET /api/diag/steptrace?motor=n     motor n's buffered steps as CSV
+void handleGetStepTrace(AsyncWebServerRequest* request) {
+    if (!request->hasParam("motor")) {
+        static StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(MOTOR_COUNT) +
+                                  MOTOR_COUNT * JSON_OBJECT_SIZE(9)> doc;
+        doc.clear();
+        JsonArray list = doc.createNestedArray("motors");
+        for (int m = 0; m < MOTOR_COUNT; m++) {
+            StepTrace& trace = stepTraces[m];
+            JsonObject motor = list.createNestedObject();
+            motor["motor"] = m + 1;
+            motor["enabled"] = trace.isActive();
+            if (!trace.isActive()) {
+                continue;
+            }
+            motor["capacity"] = trace.getCapacity();
+            motor["recorded"] = trace.getWritten();
+
+            StepEvent* events = (StepEvent*)malloc(trace.getCapacity() * sizeof(StepEvent));
+            if (events == NULL) {
+                continue;
+            }
+            StepTraceStats stats = StepTrace::analyze(events, trace.snapshot(events));
+            free(events);
+            motor["steps"] = stats.count;
+            motor["meanUs"] = stats.meanUs;
+            motor["stddevUs"] = stats.stddevUs;
+            motor["maxOvershootUs"] = stats.maxOvershootUs;
+            motor["missed"] = stats.missed;
+        }
+        sendJsonBuffer(request, doc);
         return;
     }
 
-    StaticJsonDocument<256> doc;
-    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+    int motor = request->getParam("motor")->value().toInt();
+    if (motor < 1 || motor > MOTOR_COUNT || !stepTraces[motor - 1].isActive()) {
+        request->send(404, "application/json", "{\"error\":\"Motor is not being traced\"}");
+        return;
+    }
 
-    if (error) {
-        server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+    StepTrace& trace = stepTraces[motor - 1];
+    std::shared_ptr<StepTraceExport> capture(new StepTraceExport());
+    capture->events = (StepEvent*)malloc(trace.getCapacity() * sizeof(StepEvent));
+    if (capture->events == NULL) {
+        request->send(503, "application/json", "{\"error\":\"Out of memory\"}");
         return;
     }
+    capture->count = trace.snapshot(capture->events);
+    capture->next = 0;
+    capture->headerSent = false;
+
+    // Whole lines per chunk; returning 0 ends the response
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/csv",
+        [capture](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+            size_t len = 0;
+            char line[48];
+            if (!capture->headerSent) {
+                len = snprintf((char*)buffer, maxLen, "deltaUs,targetUs,overshootUs,phase\n");
+                capture->headerSent = true;
+            }
+            while (capture->next < capture->count) {
+                const StepEvent& event = capture->events[capture->next];
+                int32_t target = event.getTargetUs();
+                int n = snprintf(line, sizeof(line), "%u,%ld,%ld,%d\n", event.deltaUs,
+                                 (long)target, (long)(event.deltaUs - target), event.getPhase());
+                if (len + n > maxLen) {
+                    break;
+                }
+                memcpy(buffer + len, line, n);
+                len += n;
+                capture->next++;
+            }
+            return len;
+        });
+    request->send(response);
+}
 
-    storedSSID = doc["ssid"].as<String>();
-    storedPassword = doc["password"].as<String>();
+// Switch tracing on or off: {"motor": n, "events": 512}, events 0 = off
+void handleSetStepTrace(AsyncWebServerRequest* request) {
+    StaticJsonDocument<64> doc;
+    if (request->_tempObject == NULL ||
+        deserializeJson(doc, (const char*)request->_tempObject)) {
+        request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
 
-    saveSettings();
+    Command cmd = {};
+    cmd.type = CMD_TRACE;
+    cmd.motor = doc["motor"] | 0;
+    cmd.traceEvents = doc["events"] | STEP_TRACE_EVENTS;
+    postCommand(request, cmd);
+}
 
-    server.send(200, "application/json",
-        "{\"success\":true,\"message\":\"Credentials saved. Rebooting...\"}");
+// Winding history streamed out one line per record. Cycles are read from
+// flash a page at a time and days one slot at a time, so the log never has
+// to fit in RAM. Shared with the response's fill callback like
+// StepTraceExport.
+struct HistoryExport {
+    bool days;                  // Daily totals rather than cycles
+    bool json;
+    int motor;                  // 0 = all
+    uint32_t since;             // Unix time
+    bool started;
+    bool finished;
+    uint32_t emitted;           // Records written, for JSON separators
+
+    // Cycles: the ring from the oldest slot, then the page still in RAM
+    HistoryPage ram;
+    int ramSlot;
+    int slotsRead;
+    HistoryPage page;
+    uint16_t next;
+    bool pageLoaded;
+
+    // Days
+    long day;
+    long latestDay;
+    int dayMotor;
+
+    char line[128];
+    size_t lineLen;
+};
+
+// Day number as YYYY-MM-DD
+void formatDay(long day, char* out, size_t size) {
+    if (day == NO_DAY) {
+        out[0] = '\0';
+        return;
+    }
+    time_t t = (time_t)day * 86400;
+    struct tm date;
+    gmtime_r(&t, &date);
+    strftime(out, size, "%Y-%m-%d", &date);
+}
 
-    delay(1000);
-    ESP.restart();
+bool nextHistoryCycle(HistoryExport& x, CycleRecord& record) {
+    for (;;) {
+        if (x.pageLoaded && x.next < x.page.header.count) {
+            record = x.page.records[x.next++];
+            if ((x.motor == 0 || record.motor == x.motor) && record.time >= x.since) {
+                return true;
+            }
+            continue;
+        }
+        if (x.slotsRead >= HISTORY_PAGES) {
+            return false;
+        }
+
+        // Every other slot of the ring, oldest first, then RAM
+        int slot = (x.ramSlot + 1 + x.slotsRead) % HISTORY_PAGES;
+        x.slotsRead++;
+        x.next = 0;
+        if (x.slotsRead == HISTORY_PAGES) {
+            x.page = x.ram;
+            x.pageLoaded = true;
+        } else {
+            x.pageLoaded = HistoryLog::readPage(slot, x.page);
+        }
+    }
 }
 
-void handleNotFound() {
+bool nextHistoryDay(HistoryExport& x, DayRecord& totals) {
+    while (x.latestDay != NO_DAY && x.day <= x.latestDay) {
+        int index = x.dayMotor++;
+        long day = x.day;
+        if (x.dayMotor >= MOTOR_COUNT) {
+            x.dayMotor = 0;
+            x.day++;
+        }
+        if ((x.motor == 0 || index == x.motor - 1) && history.getDay(index, day, totals)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Format the next line into x.line. False once everything is out.
+bool nextHistoryLine(HistoryExport& x) {
+    x.lineLen = 0;
+    if (x.finished) {
+        return false;
+    }
+    if (!x.started) {
+        x.started = true;
+        const char* header = x.json ? "[\n" : x.days ? "date,motor,cycles,target,missed,turns\n"
+                                                    : "time,date,motor,cycle,turns,interrupted\n";
+        x.lineLen = strlcpy(x.line, header, sizeof(x.line));
+        return true;
+    }
+
+    char date[16];
+    const char* separator = x.json && x.emitted > 0 ? ",\n" : "";
+    int n = 0;
+    if (x.days) {
+        DayRecord totals;
+        if (nextHistoryDay(x, totals)) {
+            formatDay(totals.day, date, sizeof(date));
+            float turns = (float)totals.halfSteps / HALF_STEPS_PER_REVOLUTION;
+            // Only days that are over can have missed cycles
+            bool closed = totals.day < x.latestDay;
+            int missed = totals.target > totals.cycles ? totals.target - totals.cycles : 0;
+            char missedText[8] = "";
+            if (closed) {
+                snprintf(missedText, sizeof(missedText), "%d", missed);
+            }
+            if (x.json) {
+                n = snprintf(x.line, sizeof(x.line),
+                             "%s{\"date\":\"%s\",\"motor\":%u,\"cycles\":%u,\"target\":%u,"
+                             "\"missed\":%s,\"turns\":%.2f}",
+                             separator, date, totals.motor, totals.cycles, totals.target,
+                             closed ? missedText : "null", turns);
+            } else {
+                n = snprintf(x.line, sizeof(x.line), "%s,%u,%u,%u,%s,%.2f\n", date, totals.motor,
+                             totals.cycles, totals.target, missedText, turns);
+            }
+        }
+    } else {
+        CycleRecord record;
+        if (nextHistoryCycle(x, record)) {
+            formatDay(record.day, date, sizeof(date));
+            float turns = (float)record.halfSteps / HALF_STEPS_PER_REVOLUTION;
+            bool interrupted = record.flags & CYCLE_INTERRUPTED;
+            if (x.json) {
+                n = snprintf(x.line, sizeof(x.line),
+                             "%s{\"time\":%lu,\"date\":\"%s\",\"motor\":%u,\"cycle\":%u,"
+                             "\"turns\":%.3f,\"interrupted\":%s}",
+                             separator, (unsigned long)record.time, date, record.motor,
+                             record.cycle, turns, interrupted ? "true" : "false");
+            } else {
+                n = snprintf(x.line, sizeof(x.line), "%lu,%s,%u,%u,%.3f,%d\n",
+                             (unsigned long)record.time, date, record.motor, record.cycle,
+                             turns, interrupted);
+            }
+        }
+    }
+
+    if (n > 0) {
+        x.emitted++;
+        x.lineLen = n;
+        return true;
+    }
+    x.finished = true;
+    if (x.json) {
+        x.lineLen = strlcpy(x.line, "\n]\n", sizeof(x.line));
+        return true;
+    }
+    return false;
+}
+
+// Winding history:
+//   GET /api/history?motor=n&since=t            cycles as CSV
+//   GET /api/history?view=days&motor=n&since=t  daily totals as CSV
+// motor and since (Unix time) are optional; add format=json for a JSON array
+void handleGetHistory(AsyncWebServerRequest* request) {
+    std::shared_ptr<HistoryExport> x(new HistoryExport());
+    x->days = request->hasParam("view") && request->getParam("view")->value() == "days";
+    x->json = request->hasParam("format") && request->getParam("format")->value() == "json";
+    x->motor = request->hasParam("motor") ? request->getParam("motor")->value().toInt() : 0;
+    x->since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+    if (x->motor < 0 || x->motor > MOTOR_COUNT) {
+        request->send(404, "application/json", "{\"error\":\"Unknown motor\"}");
+        return;
+    }
+
+    x->started = false;
+    x->finished = false;
+    x->emitted = 0;
+    history.getPage(x->ram, x->ramSlot);
+    x->slotsRead = 0;
+    x->next = 0;
+    x->pageLoaded = false;
+    x->latestDay = history.getLatestDay();
+    long sinceDay = localDay(x->since);    // Days are kept by local date
+    long firstDay = x->latestDay - HISTORY_DAYS + 1;
+    x->day = sinceDay > firstDay ? sinceDay : firstDay;
+    x->dayMotor = 0;
+    x->lineLen = 0;
+
+    // Whole lines per chunk; returning 0 ends the response
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        x->json ? "application/json" : "text/csv",
+        [x](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+            size_t len = 0;
+            while (x->lineLen > 0 || nextHistoryLine(*x)) {
+                if (len + x->lineLen > maxLen) {
+                    break;
+                }
+                memcpy(buffer + len, x->line, x->lineLen);
+                len += x->lineLen;
+                x->lineLen = 0;
+            }
+            return len;
+        });
+    request->send(response);
+}
+
+void handleNotFound(AsyncWebServerRequest* request) {
     // Captive portal redirect
     if (apMode) {
-        server.sendHeader("Location", "http://" + WiFi.softAPIP().toString(), true);
-        server.send(302, "text/plain", "");
+        request->redirect(String("http://") + ipString);
     } else {
-        server.send(404, "text/plain", "Not found");
+        request->send(404, "text/plain", "Not found");
     }
 }
 
 void loadSettings() {
+    // Start from the current (default) settings so fields missing from an
+    // older record keep their defaults
+    SettingsRecord record;
+    buildSettingsRecord(record);
+
+    if (settingsStore.load(record)) {
+        applySettingsRecord(record);
+        Serial.println("Settings loaded");
+        return;
+    }
+
+    if (loadLegacySettings()) {
+        buildSettingsRecord(record);
+        if (settingsStore.save(record)) {
+            LittleFS.remove(SETTINGS_FILE);
+        }
+        Serial.println("Settings migrated from " SETTINGS_FILE);
+        return;
+    }
+
+    Serial.println("No settings found, using defaults");
+}
+
+// Settings file written by earlier firmware
+bool loadLegacySettings() {
     File file = LittleFS.open(SETTINGS_FILE, "r");
     if (!file) {
-        Serial.println("No settings file found, using defaults");
-        return;
+        return false;
     }
 
     StaticJsonDocument<1024> doc;
@@ -435,79 +1612,100 @@ void loadSettings() {
     file.close();
 
     if (error) {
-        Serial.println("Failed to parse settings file");
-        return;
+        Serial.println("Failed to parse legacy settings file");
+        return false;
     }
 
     // Load WiFi credentials
     storedSSID = doc["wifi"]["ssid"].as<String>();
     storedPassword = doc["wifi"]["password"].as<String>();
 
-    // Load motor 1 settings
-    if (doc.containsKey("motor1")) {
-        JsonObject m1 = doc["motor1"];
-        scheduler1.setSettings(
-            m1["enabled"] | true,
-            m1["direction"] | 0,
-            m1["tpd"] | DEFAULT_TPD,
-            m1["activeHours"] | DEFAULT_ACTIVE_HOURS,
-            m1["rotationTime"] | DEFAULT_ROTATION_TIME,
-            m1["restTime"] | DEFAULT_REST_TIME
-        );
+    // Load motor settings
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        if (doc.containsKey(MOTOR_KEYS[m])) {
+            JsonObject json = doc[MOTOR_KEYS[m]];
+            schedulers[m].setSettings(
+                json["enabled"] | true,
+                json["direction"] | 0,
+                json["tpd"] | DEFAULT_TPD,
+                DEFAULT_WINDOW_START,
+                windowEndForHours(json["activeHours"] | DEFAULT_ACTIVE_HOURS),
+                json["rotationTime"] | DEFAULT_ROTATION_TIME,
+                json["restTime"] | DEFAULT_REST_TIME,
+                json["rpm"] | DEFAULT_RPM,
+                json["driveMode"] | DRIVE_HALF
+            );
+        }
     }
 
-    // Load motor 2 settings
-    if (doc.containsKey("motor2")) {
-        JsonObject m2 = doc["motor2"];
-        scheduler2.setSettings(
-            m2["enabled"] | true,
-            m2["direction"] | 0,
-            m2["tpd"] | DEFAULT_TPD,
-            m2["activeHours"] | DEFAULT_ACTIVE_HOURS,
-            m2["rotationTime"] | DEFAULT_ROTATION_TIME,
-            m2["restTime"] | DEFAULT_REST_TIME
-        );
+    return true;
+}
+
+void restoreCheckpoint() {
+    CheckpointRecord record;
+    if (!checkpoints.load(record)) {
+        return;
     }
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        schedulers[m].restore(record.motors[m]);
+    }
+}
 
-    Serial.println("Settings loaded");
+// Cheap unless a checkpoint is due
+void saveCheckpoint() {
+    SchedulerCheckpoint progress[MOTOR_COUNT];
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        schedulers[m].getCheckpoint(progress[m]);
+    }
+    checkpoints.update(progress);
 }
 
+// Settings are written behind: this only marks them dirty, and loop()
+// commits them once changes settle
 void saveSettings() {
-    StaticJsonDocument<1024> doc;
+    settingsStore.markDirty();
+}
 
-    // Save WiFi credentials
-    JsonObject wifi = doc.createNestedObject("wifi");
-    wifi["ssid"] = storedSSID;
-    wifi["password"] = storedPassword;
-
-    // Save motor 1 settings
-    MotorSettings s1 = scheduler1.getSettings();
-    JsonObject m1 = doc.createNestedObject("motor1");
-    m1["enabled"] = s1.enabled;
-    m1["direction"] = s1.direction;
-    m1["tpd"] = s1.turnsPerDay;
-    m1["activeHours"] = s1.activeHours;
-    m1["rotationTime"] = s1.rotationTime;
-    m1["restTime"] = s1.restTime;
-
-    // Save motor 2 settings
-    MotorSettings s2 = scheduler2.getSettings();
-    JsonObject m2 = doc.createNestedObject("motor2");
-    m2["enabled"] = s2.enabled;
-    m2["direction"] = s2.direction;
-    m2["tpd"] = s2.turnsPerDay;
-    m2["activeHours"] = s2.activeHours;
-    m2["rotationTime"] = s2.rotationTime;
-    m2["restTime"] = s2.restTime;
-
-    File file = LittleFS.open(SETTINGS_FILE, "w");
-    if (!file) {
-        Serial.println("Failed to open settings file for writing");
-        return;
+// Write settings to flash now
+void flushSettings() {
+    SettingsRecord record;
+    buildSettingsRecord(record);
+    if (settingsStore.save(record)) {
+        Serial.println("Settings saved");
     }
+}
 
-    serializeJson(doc, file);
-    file.close();
+void buildSettingsRecord(SettingsRecord& record) {
+    memset(&record, 0, sizeof(record));
+    strlcpy(record.ssid, storedSSID.c_str(), sizeof(record.ssid));
+    strlcpy(record.password, storedPassword.c_str(), sizeof(record.password));
+    record.motorCount = MOTOR_COUNT;
+
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        MotorSettings s = schedulers[m].getSettings();
+        StoredMotorSettings& stored = record.motors[m];
+        stored.enabled = s.enabled;
+        stored.direction = s.direction;
+        stored.rpm = s.rpm;
+        stored.windowStart = s.windowStart;
+        stored.windowEnd = s.windowEnd;
+        stored.turnsPerDay = s.turnsPerDay;
+        stored.rotationTime = s.rotationTime;
+        stored.restTime = s.restTime;
+        stored.driveMode = s.driveMode;
+    }
+}
 
-    Serial.println("Settings saved");
+void applySettingsRecord(SettingsRecord& record) {
+    record.ssid[sizeof(record.ssid) - 1] = '\0';
+    record.password[sizeof(record.password) - 1] = '\0';
+    storedSSID = record.ssid;
+    storedPassword = record.password;
+
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        const StoredMotorSettings& stored = record.motors[m];
+        schedulers[m].setSettings(stored.enabled, stored.direction, stored.turnsPerDay,
+                                  stored.windowStart, stored.windowEnd, stored.rotationTime,
+                                  stored.restTime, stored.rpm, stored.driveMode);
+    }
 }
@@ -0,0 +1,277 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+// Host stand-in for the Arduino/ESP8266 core, for `pio test -e native`.
+// Time is virtual: millis() and micros() read sim::nowUs, which only moves
+// when a test (or delay()) moves it, and wrap at 32 bits like the real ones.
+// GPIO writes are recorded instead of driving pins.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include "WString.h"
+#include "IPAddress.h"
+
+// glibc's <sched.h>, pulled in by the C++ headers, has a SCHED_IDLE macro
+// that would clash with the scheduler state
+#ifdef __GLIBC__
+#include <sched.h>
+#undef SCHED_IDLE
+#endif
+
+// Arduino cores have strlcpy; glibc only from 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t length = strlen(src);
+    if (size > 0) {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return length;
+}
+#endif
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define FPSTR(p) (p)
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+// NodeMCU pin names
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define LED_BUILTIN 2
+
+using std::min;
+using std::max;
+
+template <class T, class L, class H>
+T constrain(T x, L low, H high) {
+    return x < low ? low : (x > high ? high : x);
+}
+
+namespace sim {
+
+const int PIN_COUNT = 17;
+
+inline uint64_t nowUs = 0;          // Virtual time since boot
+inline time_t epochAtBoot = 0;      // Wall clock at boot, 0 until "SNTP" has synced
+inline bool verbose = false;        // Let Serial output through
+
+// GPIO record
+inline uint8_t pinModes[PIN_COUNT];
+inline uint8_t pinLevels[PIN_COUNT];
+inline uint32_t pinEdges[PIN_COUNT];    // Level changes per pin
+inline uint32_t pinWrites = 0;          // digitalWrite() calls
+
+inline uint32_t freeHeap = 40000;       // What ESP.getFreeHeap() reports
+inline uint32_t rtcMemory[128];         // ESP RTC user memory, 512 bytes
+
+inline void advanceUs(uint64_t us) {
+    nowUs += us;
+}
+
+inline void advanceMs(uint64_t ms) {
+    nowUs += ms * 1000;
+}
+
+// Make time() report the given Unix time from now on, as SNTP would
+inline void setEpoch(time_t epoch) {
+    epochAtBoot = epoch - (time_t)(nowUs / 1000000);
+}
+
+// Put time, GPIO and RTC memory back to power-on. Local time is UTC.
+inline void reset(uint64_t bootUs = 0) {
+    nowUs = bootUs;
+    epochAtBoot = 0;
+    memset(pinModes, 0, sizeof(pinModes));
+    memset(pinLevels, 0, sizeof(pinLevels));
+    memset(pinEdges, 0, sizeof(pinEdges));
+    pinWrites = 0;
+    memset(rtcMemory, 0, sizeof(rtcMemory));
+    setenv("TZ", "UTC0", 1);
+    tzset();
+}
+
+// Host clock, for benchmarks
+inline uint64_t hostNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace sim
+
+inline unsigned long millis() {
+    return (uint32_t)(sim::nowUs / 1000);
+}
+
+inline unsigned long micros() {
+    return (uint32_t)sim::nowUs;
+}
+
+inline void delay(unsigned long ms) {
+    sim::advanceMs(ms);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    sim::advanceUs(us);
+}
+
+inline void yield() {
+}
+
+inline void noInterrupts() {
+}
+
+inline void interrupts() {
+}
+
+// Before sync the ESP8266 counts from 1970 at boot
+inline time_t simTime(time_t* out) {
+    time_t now = sim::epochAtBoot + (time_t)(sim::nowUs / 1000000);
+    if (out) {
+        *out = now;
+    }
+    return now;
+}
+#define time(out) simTime(out)
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < sim::PIN_COUNT) {
+        sim::pinModes[pin] = mode;
+    }
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    sim::pinWrites++;
+    if (pin < sim::PIN_COUNT && sim::pinLevels[pin] != (level ? 1 : 0)) {
+        sim::pinLevels[pin] = level ? 1 : 0;
+        sim::pinEdges[pin]++;
+    }
+}
+
+inline int digitalRead(uint8_t pin) {
+    return pin < sim::PIN_COUNT ? sim::pinLevels[pin] : LOW;
+}
+
+inline void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value) {
+    for (int i = 0; i < 8; i++) {
+        int bit = bitOrder == LSBFIRST ? i : 7 - i;
+        digitalWrite(dataPin, (value >> bit) & 1);
+        digitalWrite(clockPin, HIGH);
+        digitalWrite(clockPin, LOW);
+    }
+}
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    void flush() {}
+
+    size_t print(const char* text) {
+        return sim::verbose ? fputs(text, stdout) : 0;
+    }
+
+    size_t print(const String& text) {
+        return print(text.c_str());
+    }
+
+    size_t println(const char* text = "") {
+        return sim::verbose ? printf("%s\n", text) : 0;
+    }
+
+    size_t println(const String& text) {
+        return println(text.c_str());
+    }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        if (!sim::verbose) {
+            return 0;
+        }
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+};
+
+inline HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() {
+        return sim::freeHeap;
+    }
+
+    uint16_t getMaxFreeBlockSize() {
+        return sim::freeHeap;
+    }
+
+    uint8_t getHeapFragmentation() {
+        return 0;
+    }
+
+    // Host time in 80 MHz cycles
+    uint32_t getCycleCount() {
+        return (uint32_t)(sim::hostNs() * 80 / 1000);
+    }
+
+    uint8_t getCpuFreqMHz() {
+        return 80;
+    }
+
+    uint32_t getChipId() {
+        return 0x00C0FFEE;
+    }
+
+    // Offsets and sizes as on the ESP8266: 4-byte blocks, 512 bytes in all
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > sizeof(sim::rtcMemory)) {
+            return false;
+        }
+        memcpy(data, (uint8_t*)sim::rtcMemory + offset * 4, size);
+        return true;
+    }
+
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+        if (offset * 4 + size > sizeof(sim::rtcMemory)) {
+            return false;
+        }
+        memcpy((uint8_t*)sim::rtcMemory + offset * 4, data, size);
+        return true;
+    }
+
+    void restart() {}
+};
+
+inline EspClass ESP;
+
+#endif // ARDUINO_SHIM_H
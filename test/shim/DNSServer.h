@@ -0,0 +1,13 @@
+#ifndef DNSSERVER_SHIM_H
+#define DNSSERVER_SHIM_H
+
+#include "Arduino.h"
+
+class DNSServer {
+public:
+    bool start(uint16_t, const String&, const IPAddress&) { return true; }
+    void processNextRequest() {}
+    void stop() {}
+};
+
+#endif // DNSSERVER_SHIM_H
@@ -0,0 +1,108 @@
+#ifndef ESP8266WIFI_SHIM_H
+#define ESP8266WIFI_SHIM_H
+
+// Fake WiFi. The station connects when sim::wifi.joinable is set and
+// begin() has been called; scans report sim::wifi.networks.
+
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_WRONG_PASSWORD = 6,
+    WL_DISCONNECTED = 7
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} WiFiMode_t;
+
+typedef enum {
+    WIFI_NONE_SLEEP = 0,
+    WIFI_LIGHT_SLEEP = 1,
+    WIFI_MODEM_SLEEP = 2
+} WiFiSleepType_t;
+
+#define ENC_TYPE_NONE 7
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+namespace sim {
+
+struct WiFiNetwork {
+    std::string ssid;
+    int32_t rssi;
+    bool secure;
+};
+
+struct WiFiState {
+    bool joinable = false;          // Access point in reach, credentials right
+    std::string ssid;               // From the last begin()
+    std::string password;
+    bool began = false;
+    uint32_t begins = 0;
+    WiFiMode_t mode = WIFI_OFF;
+    bool softAp = false;
+    WiFiSleepType_t sleep = WIFI_NONE_SLEEP;
+    std::vector<WiFiNetwork> networks;
+
+    void clear() {
+        *this = WiFiState();
+    }
+};
+
+inline WiFiState wifi;
+
+} // namespace sim
+
+class ESP8266WiFiClass {
+public:
+    bool mode(WiFiMode_t m) { sim::wifi.mode = m; return true; }
+    WiFiMode_t getMode() { return sim::wifi.mode; }
+    bool persistent(bool) { return true; }
+    bool setAutoReconnect(bool) { return true; }
+    bool setSleepMode(WiFiSleepType_t type, uint8_t = 0) { sim::wifi.sleep = type; return true; }
+
+    wl_status_t begin(const char* ssid, const char* password = nullptr) {
+        sim::wifi.ssid = ssid ? ssid : "";
+        sim::wifi.password = password ? password : "";
+        sim::wifi.began = true;
+        sim::wifi.begins++;
+        return status();
+    }
+
+    bool disconnect(bool = false) { sim::wifi.began = false; return true; }
+
+    wl_status_t status() {
+        return sim::wifi.began && sim::wifi.joinable ? WL_CONNECTED : WL_DISCONNECTED;
+    }
+
+    bool isConnected() { return status() == WL_CONNECTED; }
+
+    IPAddress localIP() { return isConnected() ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+    String SSID() { return String(sim::wifi.ssid.c_str()); }
+    int32_t RSSI() { return isConnected() ? -60 : 0; }
+
+    bool softAP(const char*, const char* = nullptr) { sim::wifi.softAp = true; return true; }
+    bool softAPdisconnect(bool = false) { sim::wifi.softAp = false; return true; }
+    IPAddress softAPIP() { return sim::wifi.softAp ? IPAddress(192, 168, 4, 1) : IPAddress(); }
+
+    // Scans finish straight away
+    int8_t scanNetworks(bool = false, bool = false) { return sim::wifi.networks.size(); }
+    int8_t scanComplete() { return sim::wifi.networks.size(); }
+    void scanDelete() {}
+    String SSID(uint8_t i) { return String(sim::wifi.networks[i].ssid.c_str()); }
+    int32_t RSSI(uint8_t i) { return sim::wifi.networks[i].rssi; }
+    uint8_t encryptionType(uint8_t i) { return sim::wifi.networks[i].secure ? 4 : ENC_TYPE_NONE; }
+};
+
+inline ESP8266WiFiClass WiFi;
+
+#endif // ESP8266WIFI_SHIM_H
@@ -0,0 +1,17 @@
+#ifndef ESP8266MDNS_SHIM_H
+#define ESP8266MDNS_SHIM_H
+
+#include "Arduino.h"
+
+class MDNSResponder {
+public:
+    bool begin(const char*) { return true; }
+    void end() {}
+    void update() {}
+    bool addService(const char*, const char*, uint16_t) { return true; }
+    bool notifyAPChange() { return true; }
+};
+
+inline MDNSResponder MDNS;
+
+#endif // ESP8266MDNS_SHIM_H
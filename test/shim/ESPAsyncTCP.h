@@ -0,0 +1,6 @@
+#ifndef ESPASYNCTCP_SHIM_H
+#define ESPASYNCTCP_SHIM_H
+
+// Nothing to fake - the web server shim doesn't use sockets
+
+#endif // ESPASYNCTCP_SHIM_H
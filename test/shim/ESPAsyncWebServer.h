@@ -0,0 +1,440 @@
+#ifndef ESPASYNCWEBSERVER_SHIM_H
+#define ESPASYNCWEBSERVER_SHIM_H
+
+// Fake ESPAsyncWebServer. Nothing listens; a test builds a request, hands
+// it to AsyncWebServer::handle() and reads back the response. Routing,
+// body delivery and object ownership follow the real library, so the
+// handlers allocate as they would on the device.
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "ESPAsyncTCP.h"
+#include "LittleFS.h"
+
+typedef uint8_t WebRequestMethodComposite;
+enum WebRequestMethod {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111
+};
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebServerRequest;
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t)>
+    ArBodyHandlerFunction;
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+typedef std::function<void()> ArDisconnectHandler;
+
+class AsyncWebParameter {
+private:
+    String paramName;
+    String paramValue;
+
+public:
+    AsyncWebParameter(const String& name, const String& value) : paramName(name), paramValue(value) {}
+    const String& name() const { return paramName; }
+    const String& value() const { return paramValue; }
+};
+
+class AsyncWebHeader {
+private:
+    String headerName;
+    String headerValue;
+
+public:
+    AsyncWebHeader(const String& name, const String& value) : headerName(name), headerValue(value) {}
+    const String& name() const { return headerName; }
+    const String& value() const { return headerValue; }
+};
+
+class AsyncWebServerResponse {
+protected:
+    int code;
+    String contentType;
+    std::vector<AsyncWebHeader> headers;
+
+public:
+    AsyncWebServerResponse(int status, const String& type) : code(status), contentType(type) {}
+    virtual ~AsyncWebServerResponse() {}
+
+    void setCode(int status) { code = status; }
+    void addHeader(const String& name, const String& value) { headers.emplace_back(name, value); }
+
+    // Test side
+    int getCode() const { return code; }
+    const String& getContentType() const { return contentType; }
+
+    String getHeader(const char* name) const {
+        for (const AsyncWebHeader& header : headers) {
+            if (header.name() == name) return header.value();
+        }
+        return String();
+    }
+
+    // The body as the server would send it, in TCP-sized pieces
+    virtual std::string drain(size_t chunk) = 0;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+private:
+    String content;
+
+public:
+    AsyncBasicResponse(int status, const String& type, const String& body)
+        : AsyncWebServerResponse(status, type), content(body) {}
+    std::string drain(size_t) override { return content.c_str(); }
+};
+
+class AsyncProgmemResponse : public AsyncWebServerResponse {
+private:
+    const uint8_t* content;
+    size_t length;
+
+public:
+    AsyncProgmemResponse(int status, const String& type, const uint8_t* body, size_t len)
+        : AsyncWebServerResponse(status, type), content(body), length(len) {}
+    std::string drain(size_t) override { return std::string((const char*)content, length); }
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+private:
+    AwsResponseFiller filler;
+
+public:
+    AsyncChunkedResponse(const String& type, AwsResponseFiller callback)
+        : AsyncWebServerResponse(200, type), filler(callback) {}
+
+    std::string drain(size_t chunk) override {
+        std::string out;
+        std::vector<uint8_t> buffer(chunk);
+        for (;;) {
+            size_t n = filler(buffer.data(), buffer.size(), out.size());
+            if (n == RESPONSE_TRY_AGAIN) continue;
+            if (n == 0) break;
+            out.append((const char*)buffer.data(), n);
+        }
+        return out;
+    }
+};
+
+class AsyncFileResponse : public AsyncWebServerResponse {
+private:
+    String path;
+
+public:
+    AsyncFileResponse(FS& fs, const String& file, const String& type)
+        : AsyncWebServerResponse(200, type), path(file) {
+        if (!fs.exists(path) && fs.exists(path + ".gz")) {
+            path = path + ".gz";
+            addHeader("Content-Encoding", "gzip");
+        }
+        if (!fs.exists(path)) code = 404;
+    }
+
+    std::string drain(size_t) override {
+        File file = LittleFS.open(path, "r");
+        return file ? std::string(file.readString().c_str()) : std::string();
+    }
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse {
+private:
+    std::string content;
+
+public:
+    AsyncResponseStream(const String& type) : AsyncWebServerResponse(200, type) {}
+
+    size_t write(const uint8_t* data, size_t len) { content.append((const char*)data, len); return len; }
+    size_t write(uint8_t c) { content += (char)c; return 1; }
+    size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    size_t print(const String& text) { return print(text.c_str()); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        return write((const uint8_t*)line, n < (int)sizeof(line) ? n : sizeof(line) - 1);
+    }
+
+    std::string drain(size_t) override { return content; }
+};
+
+class AsyncWebServerRequest {
+private:
+    WebRequestMethodComposite requestMethod;
+    String requestUrl;
+    std::vector<AsyncWebParameter*> parameters;
+    std::vector<AsyncWebHeader*> requestHeaders;
+    AsyncWebServerResponse* response;
+    ArDisconnectHandler disconnectHandler;
+    bool drained;
+    std::string body;
+
+public:
+    void* _tempObject;      // Freed with the request, as by the real server
+
+    AsyncWebServerRequest(WebRequestMethodComposite method, const String& url)
+        : requestMethod(method), requestUrl(url), response(nullptr), drained(false),
+          _tempObject(nullptr) {}
+
+    ~AsyncWebServerRequest() {
+        if (disconnectHandler) disconnectHandler();
+        for (AsyncWebParameter* p : parameters) delete p;
+        for (AsyncWebHeader* h : requestHeaders) delete h;
+        delete response;
+        free(_tempObject);
+    }
+
+    AsyncWebServerRequest(const AsyncWebServerRequest&) = delete;
+    AsyncWebServerRequest& operator=(const AsyncWebServerRequest&) = delete;
+
+    // Test side: query parameters and headers
+    void addParam(const String& name, const String& value) {
+        parameters.push_back(new AsyncWebParameter(name, value));
+    }
+
+    void addHeader(const String& name, const String& value) {
+        requestHeaders.push_back(new AsyncWebHeader(name, value));
+    }
+
+    const String& url() const { return requestUrl; }
+    WebRequestMethodComposite method() const { return requestMethod; }
+
+    size_t params() const { return parameters.size(); }
+    AsyncWebParameter* getParam(size_t i) const { return i < parameters.size() ? parameters[i] : nullptr; }
+
+    bool hasParam(const char* name, bool = false, bool = false) const { return getParam(name) != nullptr; }
+
+    AsyncWebParameter* getParam(const char* name, bool = false, bool = false) const {
+        for (AsyncWebParameter* p : parameters) {
+            if (p->name() == name) return p;
+        }
+        return nullptr;
+    }
+
+    bool hasHeader(const char* name) const { return getHeader(name) != nullptr; }
+
+    AsyncWebHeader* getHeader(const char* name) const {
+        for (AsyncWebHeader* h : requestHeaders) {
+            if (h->name() == name) return h;
+        }
+        return nullptr;
+    }
+
+    void onDisconnect(ArDisconnectHandler handler) { disconnectHandler = handler; }
+
+    AsyncWebServerResponse* beginResponse(int code, const String& type = String(),
+                                          const String& content = String()) {
+        return new AsyncBasicResponse(code, type, content);
+    }
+
+    AsyncWebServerResponse* beginResponse(FS& fs, const String& path, const String& type = String(),
+                                          bool = false) {
+        return new AsyncFileResponse(fs, path, type);
+    }
+
+    AsyncWebServerResponse* beginResponse_P(int code, const String& type, const uint8_t* content,
+                                            size_t len) {
+        return new AsyncProgmemResponse(code, type, content, len);
+    }
+
+    AsyncWebServerResponse* beginChunkedResponse(const String& type, AwsResponseFiller filler) {
+        return new AsyncChunkedResponse(type, filler);
+    }
+
+    AsyncResponseStream* beginResponseStream(const String& type, size_t = 1460) {
+        return new AsyncResponseStream(type);
+    }
+
+    void send(AsyncWebServerResponse* reply) {
+        delete response;
+        response = reply;
+    }
+
+    void send(int code, const String& type = String(), const String& content = String()) {
+        send(beginResponse(code, type, content));
+    }
+
+    void send(FS& fs, const String& path, const String& type = String(), bool download = false) {
+        send(beginResponse(fs, path, type, download));
+    }
+
+    void send_P(int code, const String& type, const uint8_t* content, size_t len) {
+        send(beginResponse_P(code, type, content, len));
+    }
+
+    void send_P(int code, const String& type, const char* content) {
+        send_P(code, type, (const uint8_t*)content, strlen(content));
+    }
+
+    void redirect(const String& url) {
+        AsyncWebServerResponse* reply = beginResponse(302);
+        reply->addHeader("Location", url);
+        send(reply);
+    }
+
+    // Test side: what the handler answered, 0 if nothing yet
+    AsyncWebServerResponse* getResponse() const { return response; }
+    int responseCode() const { return response ? response->getCode() : 0; }
+
+    const std::string& responseBody(size_t chunk = 1460) {
+        if (!drained && response) {
+            body = response->drain(chunk);
+            drained = true;
+        }
+        return body;
+    }
+};
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest*) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest*) {}
+    virtual void handleBody(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t) {}
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+private:
+    String uri;
+    WebRequestMethodComposite methods;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+
+public:
+    AsyncCallbackWebHandler(const char* path, WebRequestMethodComposite method,
+                            ArRequestHandlerFunction request, ArBodyHandlerFunction body)
+        : uri(path), methods(method), onRequest(request), onBody(body) {}
+
+    // A path also matches everything below it, as in the real server
+    bool canHandle(AsyncWebServerRequest* request) override {
+        if (!onRequest || !(methods & request->method())) return false;
+        return request->url() == uri || request->url().startsWith(uri + "/");
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override { onRequest(request); }
+
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index,
+                    size_t total) override {
+        if (onBody) onBody(request, data, len, index, total);
+    }
+};
+
+class AsyncEventSourceClient;
+typedef std::function<void(AsyncEventSourceClient*)> ArEventHandlerFunction;
+
+class AsyncEventSourceClient {
+private:
+    bool open = true;
+
+public:
+    void close() { open = false; }
+    bool connected() const { return open; }
+};
+
+// Server-sent events. Messages are kept for the test to look at.
+class AsyncEventSource : public AsyncWebHandler {
+public:
+    struct Message {
+        std::string event;
+        std::string data;
+    };
+
+private:
+    String url;
+    ArEventHandlerFunction connectHandler;
+    std::vector<AsyncEventSourceClient*> clients;
+
+public:
+    std::vector<Message> sent;
+
+    AsyncEventSource(const String& path) : url(path) {}
+
+    ~AsyncEventSource() {
+        for (AsyncEventSourceClient* client : clients) delete client;
+    }
+
+    void onConnect(ArEventHandlerFunction handler) { connectHandler = handler; }
+
+    size_t count() const {
+        size_t open = 0;
+        for (AsyncEventSourceClient* client : clients) open += client->connected();
+        return open;
+    }
+
+    void send(const char* message, const char* event = nullptr, uint32_t = 0, uint32_t = 0) {
+        if (count() > 0) sent.push_back({event ? event : "", message ? message : ""});
+    }
+
+    // Test side: subscribe a client, as a browser opening the stream
+    AsyncEventSourceClient* connect() {
+        AsyncEventSourceClient* client = new AsyncEventSourceClient();
+        clients.push_back(client);
+        if (connectHandler) connectHandler(client);
+        return client;
+    }
+};
+
+class AsyncWebServer {
+private:
+    std::vector<AsyncWebHandler*> handlers;
+    std::vector<AsyncCallbackWebHandler*> owned;
+    ArRequestHandlerFunction notFound;
+
+public:
+    AsyncWebServer(uint16_t) {}
+
+    ~AsyncWebServer() {
+        for (AsyncCallbackWebHandler* handler : owned) delete handler;
+    }
+
+    void begin() {}
+
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method,
+                                ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction = nullptr,
+                                ArBodyHandlerFunction onBody = nullptr) {
+        AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler(uri, method, onRequest, onBody);
+        owned.push_back(handler);
+        handlers.push_back(handler);
+        return *handler;
+    }
+
+    AsyncCallbackWebHandler& on(const char* uri, ArRequestHandlerFunction onRequest) {
+        return on(uri, HTTP_ANY, onRequest);
+    }
+
+    void addHandler(AsyncWebHandler* handler) { handlers.push_back(handler); }
+    void onNotFound(ArRequestHandlerFunction handler) { notFound = handler; }
+
+    // Test side: deliver a request, body first, to the first handler that
+    // takes it. The body arrives in pieces of at most `chunk` bytes.
+    void handle(AsyncWebServerRequest& request, const char* body = nullptr, size_t chunk = 1460) {
+        for (AsyncWebHandler* handler : handlers) {
+            if (!handler->canHandle(&request)) continue;
+            size_t total = body ? strlen(body) : 0;
+            for (size_t index = 0; index < total; index += chunk) {
+                size_t len = total - index < chunk ? total - index : chunk;
+                handler->handleBody(&request, (uint8_t*)body + index, len, index, total);
+            }
+            handler->handleRequest(&request);
+            return;
+        }
+        if (notFound) notFound(&request);
+    }
+};
+
+#endif // ESPASYNCWEBSERVER_SHIM_H
@@ -0,0 +1,26 @@
+#ifndef IPADDRESS_SHIM_H
+#define IPADDRESS_SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+class IPAddress {
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+
+    uint8_t operator[](int i) const { return octets[i]; }
+    bool isSet() const { return octets[0] || octets[1] || octets[2] || octets[3]; }
+
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return String(text);
+    }
+};
+
+#endif // IPADDRESS_SHIM_H
@@ -0,0 +1,297 @@
+#ifndef LITTLEFS_SHIM_H
+#define LITTLEFS_SHIM_H
+
+// In-memory LittleFS. Files live in sim::fs, which also counts writes and
+// can cut the power part way through one.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+namespace sim {
+
+struct FlashState {
+    std::map<std::string, std::vector<uint8_t>> files;
+    uint32_t writes = 0;            // write() calls that stored anything
+    uint32_t bytesWritten = 0;
+    int64_t writeBudget = -1;       // Bytes left before the power cut, -1 for none
+    bool powerLost = false;         // Budget ran out; nothing more is stored
+
+    // Forget every file and counter
+    void clear() {
+        *this = FlashState();
+    }
+
+    // Power fails once this many more bytes have been written
+    void cutPowerAfter(int64_t bytes) {
+        writeBudget = bytes;
+        powerLost = false;
+    }
+
+    // Power is back, e.g. for the next boot
+    void restorePower() {
+        writeBudget = -1;
+        powerLost = false;
+    }
+
+    void resetCounters() {
+        writes = 0;
+        bytesWritten = 0;
+    }
+
+    // Flip the bits of one stored byte
+    bool corrupt(const char* path, size_t offset) {
+        auto file = files.find(path);
+        if (file == files.end() || offset >= file->second.size()) {
+            return false;
+        }
+        file->second[offset] ^= 0xFF;
+        return true;
+    }
+
+    size_t size(const char* path) {
+        auto file = files.find(path);
+        return file == files.end() ? 0 : file->second.size();
+    }
+};
+
+inline FlashState fs;
+
+} // namespace sim
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File {
+private:
+    struct Handle {
+        std::string path;
+        size_t position;
+        bool readable;
+        bool writable;
+        bool append;
+    };
+    std::shared_ptr<Handle> handle;
+
+    std::vector<uint8_t>* data() const {
+        if (!handle) {
+            return nullptr;
+        }
+        auto file = sim::fs.files.find(handle->path);
+        return file == sim::fs.files.end() ? nullptr : &file->second;
+    }
+
+public:
+    File() {}
+
+    File(const std::string& path, bool readable, bool writable, bool append)
+        : handle(new Handle{path, 0, readable, writable, append}) {
+        if (append) {
+            handle->position = data()->size();
+        }
+    }
+
+    explicit operator bool() const {
+        return data() != nullptr;
+    }
+
+    const char* name() const {
+        return handle ? handle->path.c_str() : "";
+    }
+
+    size_t size() const {
+        std::vector<uint8_t>* bytes = data();
+        return bytes ? bytes->size() : 0;
+    }
+
+    size_t position() const {
+        return handle ? handle->position : 0;
+    }
+
+    int available() const {
+        return (int)(size() - std::min(size(), position()));
+    }
+
+    // Seeking past the end is allowed; a write there fills the gap with zeros
+    bool seek(uint32_t offset, SeekMode mode = SeekSet) {
+        if (!data()) {
+            return false;
+        }
+        size_t base = mode == SeekSet ? 0 : mode == SeekCur ? handle->position : size();
+        handle->position = base + offset;
+        return true;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) {
+        std::vector<uint8_t>* bytes = data();
+        if (!bytes || !handle->readable || handle->position >= bytes->size()) {
+            return 0;
+        }
+        size_t n = std::min(length, bytes->size() - handle->position);
+        memcpy(buffer, bytes->data() + handle->position, n);
+        handle->position += n;
+        return n;
+    }
+
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        return read((uint8_t*)buffer, length);
+    }
+
+    int peek() {
+        std::vector<uint8_t>* bytes = data();
+        return bytes && handle->position < bytes->size() ? (*bytes)[handle->position] : -1;
+    }
+
+    String readStringUntil(char terminator) {
+        String out;
+        int c;
+        while ((c = read()) >= 0 && c != terminator) {
+            out += (char)c;
+        }
+        return out;
+    }
+
+    String readString() {
+        String out;
+        int c;
+        while ((c = read()) >= 0) {
+            out += (char)c;
+        }
+        return out;
+    }
+
+    // Stores as much as the power budget allows
+    size_t write(const uint8_t* buffer, size_t length) {
+        std::vector<uint8_t>* bytes = data();
+        if (!bytes || !handle->writable || sim::fs.powerLost) {
+            return 0;
+        }
+        size_t n = length;
+        if (sim::fs.writeBudget >= 0 && (int64_t)n > sim::fs.writeBudget) {
+            n = (size_t)sim::fs.writeBudget;
+            sim::fs.powerLost = true;
+        }
+        if (sim::fs.writeBudget >= 0) {
+            sim::fs.writeBudget -= n;
+        }
+        if (handle->append) {
+            handle->position = bytes->size();
+        }
+        if (bytes->size() < handle->position + n) {
+            bytes->resize(handle->position + n);
+        }
+        memcpy(bytes->data() + handle->position, buffer, n);
+        handle->position += n;
+        if (n > 0) {
+            sim::fs.writes++;
+            sim::fs.bytesWritten += n;
+        }
+        return n;
+    }
+
+    size_t write(uint8_t c) {
+        return write(&c, 1);
+    }
+
+    size_t print(const char* text) {
+        return write((const uint8_t*)text, strlen(text));
+    }
+
+    size_t print(const String& text) {
+        return print(text.c_str());
+    }
+
+    size_t println(const char* text = "") {
+        return print(text) + print("\n");
+    }
+
+    void flush() {}
+
+    void close() {
+        handle.reset();
+    }
+};
+
+class FS {
+public:
+    bool begin() {
+        return true;
+    }
+
+    void end() {}
+
+    bool format() {
+        sim::fs.files.clear();
+        return true;
+    }
+
+    bool exists(const char* path) {
+        return sim::fs.files.count(path) > 0;
+    }
+
+    bool exists(const String& path) {
+        return exists(path.c_str());
+    }
+
+    // Modes as fopen(): r, r+, w, w+, a, a+
+    File open(const char* path, const char* mode) {
+        bool plus = strchr(mode, '+') != nullptr;
+        auto file = sim::fs.files.find(path);
+        switch (mode[0]) {
+            case 'r':
+                if (file == sim::fs.files.end()) {
+                    return File();
+                }
+                return File(path, true, plus, false);
+            case 'w':
+                if (sim::fs.powerLost) {
+                    return File();
+                }
+                sim::fs.files[path].clear();
+                return File(path, plus, true, false);
+            case 'a':
+                if (sim::fs.powerLost) {
+                    return File();
+                }
+                sim::fs.files[path];
+                return File(path, plus, true, true);
+        }
+        return File();
+    }
+
+    File open(const String& path, const char* mode) {
+        return open(path.c_str(), mode);
+    }
+
+    bool remove(const char* path) {
+        if (sim::fs.powerLost) {
+            return false;
+        }
+        return sim::fs.files.erase(path) > 0;
+    }
+
+    bool rename(const char* from, const char* to) {
+        auto file = sim::fs.files.find(from);
+        if (file == sim::fs.files.end() || sim::fs.powerLost) {
+            return false;
+        }
+        std::vector<uint8_t> bytes = std::move(file->second);
+        sim::fs.files.erase(file);
+        sim::fs.files[to] = std::move(bytes);
+        return true;
+    }
+};
+
+inline FS LittleFS;
+
+#endif // LITTLEFS_SHIM_H
@@ -0,0 +1,113 @@
+#ifndef WSTRING_SHIM_H
+#define WSTRING_SHIM_H
+
+// Arduino String on top of std::string, so it allocates like the real one
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+
+class String {
+private:
+    std::string text;
+
+    static std::string format(double value, unsigned int decimals) {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+        return buffer;
+    }
+
+public:
+    String() {}
+    String(const char* c) : text(c ? c : "") {}
+    String(const std::string& s) : text(s) {}
+    explicit String(char c) : text(1, c) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned int value) : text(std::to_string(value)) {}
+    String(long value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+    String(long long value) : text(std::to_string(value)) {}
+    String(unsigned long long value) : text(std::to_string(value)) {}
+    String(float value, unsigned int decimals = 2) : text(format(value, decimals)) {}
+    String(double value, unsigned int decimals = 2) : text(format(value, decimals)) {}
+
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    bool isEmpty() const { return text.empty(); }
+    bool reserve(unsigned int size) { text.reserve(size); return true; }
+
+    bool concat(const char* s) { text += s ? s : ""; return true; }
+    bool concat(const char* s, unsigned int n) { text.append(s, n); return true; }
+    bool concat(const String& s) { text += s.text; return true; }
+    bool concat(char c) { text += c; return true; }
+
+    String& operator+=(const String& s) { text += s.text; return *this; }
+    String& operator+=(const char* s) { text += s ? s : ""; return *this; }
+    String& operator+=(char c) { text += c; return *this; }
+
+    bool operator==(const String& s) const { return text == s.text; }
+    bool operator==(const char* s) const { return text == (s ? s : ""); }
+    bool operator!=(const String& s) const { return text != s.text; }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator<(const String& s) const { return text < s.text; }
+    bool equals(const String& s) const { return text == s.text; }
+
+    char operator[](unsigned int i) const { return i < text.size() ? text[i] : 0; }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t pos = text.find(c, from);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+
+    int indexOf(const String& s, unsigned int from = 0) const {
+        size_t pos = text.find(s.text, from);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+
+    int lastIndexOf(char c) const {
+        size_t pos = text.rfind(c);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+
+    String substring(unsigned int from) const {
+        return from < text.size() ? String(text.substr(from)) : String();
+    }
+
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        return from < text.size() ? String(text.substr(from, to - from)) : String();
+    }
+
+    bool startsWith(const String& s) const { return text.compare(0, s.text.size(), s.text) == 0; }
+
+    bool endsWith(const String& s) const {
+        return text.size() >= s.text.size() &&
+               text.compare(text.size() - s.text.size(), s.text.size(), s.text) == 0;
+    }
+
+    void trim() {
+        size_t start = 0;
+        while (start < text.size() && isspace((unsigned char)text[start])) start++;
+        size_t end = text.size();
+        while (end > start && isspace((unsigned char)text[end - 1])) end--;
+        text = text.substr(start, end - start);
+    }
+
+    void toLowerCase() {
+        for (char& c : text) c = tolower((unsigned char)c);
+    }
+
+    long toInt() const { return atol(text.c_str()); }
+    float toFloat() const { return atof(text.c_str()); }
+
+    friend String operator+(const String& a, const String& b) { return String(a.text + b.text); }
+    friend String operator+(const String& a, const char* b) { return String(a.text + (b ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b.text); }
+    friend String operator+(const String& a, char b) { return String(a.text + b); }
+};
+
+#endif // WSTRING_SHIM_H
@@ -0,0 +1,223 @@
+#ifndef WINDER_SIM_H
+#define WINDER_SIM_H
+
+// The scheduling half of the firmware's loop() on virtual time: motors on
+// the step engine, schedulers run from a deadline heap and the engine's
+// completion flags, bursts gated by the power budget. While no motor turns,
+// time skips straight to the next deadline, so a simulated day takes
+// seconds.
+
+#include <Arduino.h>
+#include <limits.h>
+#include "config.h"
+#include "stepper.h"
+#include "step_engine.h"
+#include "scheduler.h"
+#include "power_budget.h"
+#include "deadline_queue.h"
+#include "wall_clock.h"
+
+const time_t SIM_MIDNIGHT = 1704067200;     // 2024-01-01 00:00 UTC
+const uint64_t SIM_HOUR_US = 3600ULL * 1000000;
+
+// Unix time `day` days and `hour`:`minute` after SIM_MIDNIGHT
+inline time_t simAt(int day, int hour, int minute = 0) {
+    return SIM_MIDNIGHT + day * 86400 + hour * 3600 + minute * 60;
+}
+
+class WinderSim {
+public:
+    static const int MAX_MOTORS = STEP_ENGINE_MAX_MOTORS;
+
+    Stepper motors[MAX_MOTORS];
+    Scheduler schedulers[MAX_MOTORS];
+    PowerBudget budget;
+    WallClock wallClock;
+    DeadlineQueue<MAX_MOTORS> deadlines;
+    int count;
+
+    // Counters
+    uint64_t loops;
+    uint64_t schedulerRuns;
+    uint32_t peakMa;            // Highest motor current after any burst start
+
+    // Boot with the given number of motors at default settings. The power
+    // budget gates bursts when asked and when it has a slot per motor.
+    explicit WinderSim(int motorCount, bool gated = true) {
+        sim::reset();
+        StepEngine::end();
+        count = motorCount;
+        loops = 0;
+        schedulerRuns = 0;
+        peakMa = 0;
+        completed = 0;
+        for (int i = 0; i < count; i++) {
+            wire(i);
+            motors[i].begin();
+            StepEngine::attach(&motors[i]);
+            bool budgeted = i < MOTOR_COUNT;
+            if (budgeted) {
+                budget.attach(i, &motors[i]);
+            }
+            schedulers[i].attach(&motors[i], i + 1, gated && budgeted ? &budget : nullptr);
+        }
+        StepEngine::begin();
+    }
+
+    ~WinderSim() {
+        StepEngine::end();
+    }
+
+    // Same settings on every motor, as the web UI would apply them
+    void configureAll(int tpd, int windowStart, int windowEnd, int rotationTime, int restTime,
+                      int rpm, int driveMode = DRIVE_HALF) {
+        for (int i = 0; i < count; i++) {
+            schedulers[i].setSettings(true, DIR_CLOCKWISE, tpd, windowStart, windowEnd,
+                                      rotationTime, restTime, rpm, driveMode);
+        }
+    }
+
+    void startAll() {
+        for (int i = 0; i < count; i++) {
+            schedulers[i].start();
+            deadlines.schedule(i, millis());
+        }
+    }
+
+    bool anyRunning() {
+        for (int i = 0; i < count; i++) {
+            if (motors[i].isRunning()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // One pass of the scheduling part of loop()
+    void loopOnce() {
+        loops++;
+        StepEngine::poll();
+
+        const ClockReading& clock = wallClock.read();
+        completed |= StepEngine::takeCompleted();
+        while (completed) {
+            runScheduler(__builtin_ctz(completed), clock);
+            completed &= completed - 1;
+        }
+        unsigned int due;
+        for (int n = 0; n < count && deadlines.popDue(millis(), due); n++) {
+            runScheduler(due, clock);
+        }
+        for (int n = 0; n < count && budget.nextReady(due); n++) {
+            runScheduler(due, clock);
+        }
+
+        // Bursts only start in the schedulers
+        uint32_t energized = budget.energizedMa();
+        if (energized > peakMa) {
+            peakMa = energized;
+        }
+    }
+
+    // Loop for a stretch of virtual time. While motors turn, only the step
+    // engine has work until a burst ends or a deadline passes, so it is
+    // ticked on its own; otherwise time skips to the next deadline.
+    void runFor(uint64_t us) {
+        uint64_t end = sim::nowUs + us;
+        while (sim::nowUs < end) {
+            loopOnce();
+            unsigned long ms = deadlines.msUntilNext(millis());
+            uint64_t until = ms == ULONG_MAX ? end : sim::nowUs + (uint64_t)ms * 1000;
+            if (until > end) {
+                until = end;
+            }
+            if (anyRunning()) {
+                do {
+                    sim::advanceUs(STEP_TICK_US);
+                    StepEngine::poll();
+                    completed |= StepEngine::takeCompleted();
+                } while (!completed && sim::nowUs < until);
+            } else {
+                sim::advanceUs(until > sim::nowUs + STEP_TICK_US ? until - sim::nowUs : STEP_TICK_US);
+            }
+        }
+    }
+
+    // loop() held up for a while (a slow handler, a flash write): only the
+    // step engine interrupt keeps running
+    void stall(uint64_t us) {
+        uint64_t end = sim::nowUs + us;
+        while (sim::nowUs < end) {
+            sim::advanceUs(STEP_TICK_US);
+            StepEngine::poll();
+        }
+    }
+
+    // Run until the wall clock reads the given Unix time
+    void runUntil(time_t epoch) {
+        time_t now = time(nullptr);
+        if (epoch > now) {
+            runFor((uint64_t)(epoch - now) * 1000000);
+        }
+    }
+
+    // Half-steps counted towards today's target
+    uint32_t stepsToday(int index) {
+        SchedulerCheckpoint cp;
+        schedulers[index].getCheckpoint(cp);
+        return cp.stepsToday;
+    }
+
+    // Coil outputs of a motor that are on right now
+    int coilsOn(int index) {
+        int on = 0;
+        for (int pin = 0; pin < sim::PIN_COUNT; pin++) {
+            if (pinsOf(index) & (1UL << pin)) {
+                on += sim::pinLevels[pin];
+            }
+        }
+        return on;
+    }
+
+private:
+    uint32_t completed;         // Engine completion flags not yet handled
+
+    void runScheduler(int index, const ClockReading& clock) {
+        schedulerRuns++;
+        schedulers[index].update(clock);
+        unsigned long ms = schedulers[index].msUntilNextWork();
+        if (ms == ULONG_MAX) {
+            deadlines.cancel(index);
+        } else {
+            deadlines.schedule(index, millis() + ms);
+        }
+    }
+
+    // Motors past the wired pins share them; only the first two (GPIO) or
+    // MOTOR_COUNT (shift register) have outputs of their own
+    static uint32_t pinsOf(int index) {
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER
+        (void)index;
+        return 0;
+#else
+        return index % 2 == 0
+            ? PhaseMasks::forPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4).coils
+            : PhaseMasks::forPins(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4).coils;
+#endif
+    }
+
+    void wire(int index) {
+#if COIL_OUTPUT == COIL_OUTPUT_SHIFT_REGISTER
+        int base = (index % MOTOR_COUNT) * 4;
+        motors[index].setPins(base, base + 1, base + 2, base + 3);
+#else
+        if (index % 2 == 0) {
+            motors[index].setPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4);
+        } else {
+            motors[index].setPins(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4);
+        }
+#endif
+    }
+};
+
+#endif // WINDER_SIM_H
@@ -0,0 +1,131 @@
+// Cycles to put one half-step of both motors on the coils: one
+// GpioCoilOutput frame against four digitalWrite() calls per motor, as
+// before the frame existed. Runs on the host and on the board:
+//   pio test -e native -f test_bench_coil_output
+//   pio test -e nodemcu -f test_bench_coil_output
+// Host numbers are host time in 80 MHz cycles, and there GpioCoilOutput
+// falls back to digitalWrite() itself, so only the board compares the two.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "coil_output.h"
+#include "stepper.h"
+
+const int ROUNDS = 4000;
+
+const int PINS[2][4] = {
+    {MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4},
+    {MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4}
+};
+
+// Half-step table the digitalWrite() path used
+const int LEGACY_SEQUENCE[8][4] = {
+    {1, 0, 0, 0},
+    {1, 1, 0, 0},
+    {0, 1, 0, 0},
+    {0, 1, 1, 0},
+    {0, 0, 1, 0},
+    {0, 0, 1, 1},
+    {0, 0, 0, 1},
+    {1, 0, 0, 1}
+};
+
+constexpr PhaseMasks MASKS[2] = {
+    PhaseMasks::forPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4),
+    PhaseMasks::forPins(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4)
+};
+
+static void IRAM_ATTR writeLegacy(int phase) {
+    for (int m = 0; m < 2; m++) {
+        for (int i = 0; i < 4; i++) {
+            digitalWrite(PINS[m][i], LEGACY_SEQUENCE[phase][i]);
+        }
+    }
+}
+
+static void IRAM_ATTR writeFrame(int phase) {
+    CoilFrame frame = {0, 0};
+    for (int m = 0; m < 2; m++) {
+        uint32_t on = MASKS[m].phase[phase];
+        frame.set |= on;
+        frame.clear |= MASKS[m].coils & ~on;
+    }
+    GpioCoilOutput::write(frame);
+}
+
+// Average cycles per call, interrupts off so the step engine can't add to it
+static uint32_t cyclesPerStep(void (*write)(int)) {
+    noInterrupts();
+    uint32_t start = ESP.getCycleCount();
+    for (int r = 0; r < ROUNDS; r++) {
+        write(r & 7);
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    interrupts();
+    return cycles / ROUNDS;
+}
+
+static uint32_t coilLevels() {
+    uint32_t levels = 0;
+    for (int m = 0; m < 2; m++) {
+        for (int i = 0; i < 4; i++) {
+            levels |= (uint32_t)digitalRead(PINS[m][i]) << (m * 4 + i);
+        }
+    }
+    return levels;
+}
+
+void setUp() {
+    GpioCoilOutput::begin(MASKS[0].coils | MASKS[1].coils);
+}
+
+void tearDown() {
+    GpioCoilOutput::write({0, MASKS[0].coils | MASKS[1].coils});
+}
+
+// Both paths leave the same coils on for every phase
+void test_same_outputs() {
+    for (int phase = 0; phase < 8; phase++) {
+        writeLegacy(phase);
+        uint32_t legacy = coilLevels();
+        GpioCoilOutput::write({0, MASKS[0].coils | MASKS[1].coils});
+        writeFrame(phase);
+        TEST_ASSERT_EQUAL_HEX32(legacy, coilLevels());
+    }
+}
+
+void test_cycles_per_step() {
+    uint32_t legacy = cyclesPerStep(writeLegacy);
+    uint32_t frame = cyclesPerStep(writeFrame);
+
+    char line[96];
+    snprintf(line, sizeof(line), "cycles per step, 2 motors: digitalWrite %u, frame %u",
+             (unsigned)legacy, (unsigned)frame);
+    TEST_MESSAGE(line);
+#ifdef ARDUINO_ARCH_ESP8266
+    // Two register stores against eight calls into the core
+    TEST_ASSERT_LESS_THAN(legacy / 4, frame);
+#endif
+}
+
+static int runBenchmarks() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_outputs);
+    RUN_TEST(test_cycles_per_step);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO_ARCH_ESP8266
+void setup() {
+    delay(2000);    // Let the test runner open the serial port
+    runBenchmarks();
+}
+
+void loop() {
+}
+#else
+int main() {
+    return runBenchmarks();
+}
+#endif
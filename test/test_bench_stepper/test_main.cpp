@@ -0,0 +1,174 @@
+// Cycles per step and RAM of the stepper's phase handling against the class
+// before the packed sequence: int pins[4] and currentStep per motor, the
+// shared int[8][4] table, a branch to wrap the phase, and a digitalWrite()
+// per coil. Runs on the host and on the board:
+//   pio test -e native -f test_bench_stepper
+//   pio test -e nodemcu -f test_bench_stepper
+// The host only checks the outputs and the RAM sums. Its clock is far too
+// coarse for a few dozen cycles, so the cycle counts come from the board.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "coil_output.h"
+#include "stepper.h"
+
+const int ROUNDS = 4000;
+
+// Half-step table the old class used, shared by every motor
+const int LEGACY_STEP_SEQUENCE[8][4] = {
+    {1, 0, 0, 0},
+    {1, 1, 0, 0},
+    {0, 1, 0, 0},
+    {0, 1, 1, 0},
+    {0, 0, 1, 0},
+    {0, 0, 1, 1},
+    {0, 0, 0, 1},
+    {1, 0, 0, 1}
+};
+
+// The old class's phase state and step
+class LegacyStepper {
+private:
+    int pins[4];
+    int currentStep;
+
+public:
+    LegacyStepper(int in1, int in2, int in3, int in4) {
+        pins[0] = in1;
+        pins[1] = in2;
+        pins[2] = in3;
+        pins[3] = in4;
+        currentStep = 0;
+    }
+
+    void IRAM_ATTR stepMotor(bool clockwise) {
+        if (clockwise) {
+            currentStep--;
+            if (currentStep < 0) currentStep = 7;
+        } else {
+            currentStep++;
+            if (currentStep >= 8) currentStep = 0;
+        }
+
+        for (int i = 0; i < 4; i++) {
+            digitalWrite(pins[i], LEGACY_STEP_SEQUENCE[currentStep][i]);
+        }
+    }
+};
+
+const int PINS[4] = {MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4};
+
+LegacyStepper legacy(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4);
+Stepper motor;
+
+// The new path all the way to the coils: phase masks into a frame, and the
+// frame onto the pins
+static void IRAM_ATTR stepPacked(bool clockwise) {
+    CoilFrame frame = {0, 0};
+    motor.stepMotor(clockwise, frame);
+    GpioCoilOutput::write(frame);
+}
+
+static void IRAM_ATTR stepLegacy(bool clockwise) {
+    legacy.stepMotor(clockwise);
+}
+
+static uint32_t coilLevels() {
+    uint32_t levels = 0;
+    for (int i = 0; i < 4; i++) {
+        levels |= (uint32_t)digitalRead(PINS[i]) << i;
+    }
+    return levels;
+}
+
+void setUp() {
+    motor.setPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4);
+    GpioCoilOutput::begin(PhaseMasks::forPins(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4).coils);
+}
+
+void tearDown() {
+}
+
+// Same coils for every step, both ways round the wrap
+void test_same_outputs() {
+    for (int i = 0; i < 40; i++) {
+        bool clockwise = (i / 20) == 0;
+        stepLegacy(clockwise);
+        uint32_t old = coilLevels();
+        stepPacked(clockwise);
+        TEST_ASSERT_EQUAL_HEX32(old, coilLevels());
+    }
+}
+
+#ifdef ARDUINO_ARCH_ESP8266
+// Average cycles per step, interrupts off so the step engine can't add to it
+static uint32_t cyclesPerStep(void (*step)(bool)) {
+    noInterrupts();
+    uint32_t start = ESP.getCycleCount();
+    for (int r = 0; r < ROUNDS; r++) {
+        step(r & 64);
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    interrupts();
+    return cycles / ROUNDS;
+}
+#endif
+
+void test_cycles_per_step() {
+#ifdef ARDUINO_ARCH_ESP8266
+    uint32_t old = cyclesPerStep(stepLegacy);
+    uint32_t now = cyclesPerStep(stepPacked);
+
+    char line[96];
+    snprintf(line, sizeof(line), "cycles per step: old %u, packed %u", (unsigned)old, (unsigned)now);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(old, now);
+#else
+    TEST_IGNORE_MESSAGE("cycle counts are only measured on the board");
+#endif
+}
+
+// Phase state of each motor, plus the table once. The packed masks cost
+// more per motor but need no table, so they win up to six motors.
+static size_t legacyBytes(int motors) {
+    return motors * sizeof(LegacyStepper) + sizeof(LEGACY_STEP_SEQUENCE);
+}
+
+static size_t packedBytes(int motors) {
+    return motors * (sizeof(PhaseMasks) + sizeof(int));    // Masks and currentStep
+}
+
+void test_ram() {
+    char line[128];
+    snprintf(line, sizeof(line),
+             "RAM: old %u bytes per motor + %u for the table, packed %u per motor; "
+             "2 motors %u vs %u, 8 motors %u vs %u",
+             (unsigned)sizeof(LegacyStepper), (unsigned)sizeof(LEGACY_STEP_SEQUENCE),
+             (unsigned)packedBytes(1), (unsigned)legacyBytes(2), (unsigned)packedBytes(2),
+             (unsigned)legacyBytes(8), (unsigned)packedBytes(8));
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(legacyBytes(2), packedBytes(2));
+}
+
+static int runBenchmarks() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_outputs);
+    RUN_TEST(test_cycles_per_step);
+    RUN_TEST(test_ram);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO_ARCH_ESP8266
+void setup() {
+    delay(2000);    // Let the test runner open the serial port
+    runBenchmarks();
+}
+
+void loop() {
+}
+#else
+int main() {
+    return runBenchmarks();
+}
+#endif
@@ -0,0 +1,78 @@
+// Winding history: no cycle is lost to a page that fills up between
+// flushes, and every running day gets its totals.
+
+#include <unity.h>
+#include <winder_sim.h>
+#include "history_log.h"
+
+const long SIM_DAY = SIM_MIDNIGHT / 86400;
+
+void setUp() {
+    sim::fs.clear();
+}
+
+void tearDown() {
+}
+
+// Three pages and a bit without a flush(): the full pages go to flash as
+// the next record arrives, the rest waits in RAM
+void test_full_page_is_written_not_dropped() {
+    sim::reset();
+    sim::setEpoch(simAt(0, 9));
+    HistoryLog log;
+    log.begin();
+
+    const int total = HISTORY_PAGE_RECORDS * 3 + 5;
+    for (int i = 0; i < total; i++) {
+        log.append(1, SIM_DAY, i + 1, HALF_STEPS_PER_REVOLUTION, total, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, log.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(total, log.getAppended());
+
+    HistoryPage page;
+    for (int slot = 0; slot < 3; slot++) {
+        TEST_ASSERT_TRUE(HistoryLog::readPage(slot, page));
+        TEST_ASSERT_EQUAL(HISTORY_PAGE_RECORDS, page.header.count);
+        for (int r = 0; r < HISTORY_PAGE_RECORDS; r++) {
+            TEST_ASSERT_EQUAL(slot * HISTORY_PAGE_RECORDS + r + 1, page.records[r].cycle);
+        }
+    }
+
+    int slot;
+    log.getPage(page, slot);
+    TEST_ASSERT_EQUAL(3, slot);
+    TEST_ASSERT_EQUAL(5, page.header.count);
+    TEST_ASSERT_EQUAL(total, page.records[4].cycle);
+}
+
+// The day's totals exist from the moment its window opens, before any
+// cycle, so a day that never gets one still reports its missed cycles
+void test_day_without_cycles_is_recorded() {
+    WinderSim sim(1);
+    HistoryLog log;
+    log.begin();
+    sim.schedulers[0].attach(&sim.motors[0], 1, &sim.budget, &log);
+    sim::setEpoch(simAt(0, 8));
+    sim.startAll();
+    sim.loopOnce();
+
+    int planned = sim.schedulers[0].getSettings().cyclesPerDay;
+    DayRecord totals;
+    TEST_ASSERT_TRUE(log.getDay(0, SIM_DAY, totals));
+    TEST_ASSERT_EQUAL(0, totals.cycles);
+    TEST_ASSERT_EQUAL(planned, totals.target);
+
+    // Opening the next day sets this one aside for flash
+    log.startDay(1, SIM_DAY + 1, planned);
+    log.flush();
+    TEST_ASSERT_TRUE(log.getDay(0, SIM_DAY, totals));
+    TEST_ASSERT_EQUAL(0, totals.cycles);
+    TEST_ASSERT_EQUAL(planned, totals.target);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_page_is_written_not_dropped);
+    RUN_TEST(test_day_without_cycles_is_recorded);
+    return UNITY_END();
+}
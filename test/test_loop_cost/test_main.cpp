@@ -0,0 +1,99 @@
+// Cost of the scheduling part of loop() and of a step engine tick with 2, 8
+// and 32 motors, on virtual time. Times are host nanoseconds, so they
+// compare motor counts rather than predict the board; the scheduler run
+// counts are exact.
+
+#include <unity.h>
+#include <winder_sim.h>
+
+static_assert(STEP_ENGINE_MAX_MOTORS >= 32, "Build with -D STEP_ENGINE_MAX_MOTORS=32");
+
+const int LOOPS = 20000;
+const int TICKS = 20000;
+
+struct LoopCost {
+    uint64_t idleLoopNs;        // loop() with nothing due
+    uint64_t tickNs;            // Engine tick with every motor turning
+    uint64_t schedulerRuns;     // In half an hour of winding
+    int cycles;                 // Bursts completed in that time
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Every motor on the default schedule, all bursts at once
+static LoopCost measure(int motorCount) {
+    WinderSim sim(motorCount, false);
+    sim::setEpoch(simAt(0, 8));
+    sim.startAll();
+    sim.loopOnce();
+    TEST_ASSERT_TRUE(sim.anyRunning());
+
+    LoopCost cost;
+    uint64_t start = sim::hostNs();
+    for (int i = 0; i < TICKS; i++) {
+        sim::advanceUs(STEP_TICK_US);
+        StepEngine::poll();
+    }
+    cost.tickNs = (sim::hostNs() - start) / TICKS;
+
+    // Into the rest after the first bursts
+    sim.runFor(60 * 1000000ULL);
+    TEST_ASSERT_FALSE(sim.anyRunning());
+    start = sim::hostNs();
+    for (int i = 0; i < LOOPS; i++) {
+        sim.loopOnce();
+    }
+    cost.idleLoopNs = (sim::hostNs() - start) / LOOPS;
+
+    sim.schedulerRuns = 0;
+    int before = 0;
+    for (int m = 0; m < motorCount; m++) {
+        before += sim.schedulers[m].getCompletedCycles();
+    }
+    sim.runFor(SIM_HOUR_US / 2);
+    cost.schedulerRuns = sim.schedulerRuns;
+    cost.cycles = -before;
+    for (int m = 0; m < motorCount; m++) {
+        cost.cycles += sim.schedulers[m].getCompletedCycles();
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%2d motors: idle loop %llu ns, tick %llu ns, %llu scheduler runs for %d bursts",
+             motorCount, (unsigned long long)cost.idleLoopNs, (unsigned long long)cost.tickNs,
+             (unsigned long long)cost.schedulerRuns, cost.cycles);
+    TEST_MESSAGE(line);
+    return cost;
+}
+
+// Schedulers run when one of theirs is due, not on every loop: a start and
+// an end per burst, and no more as the motor count grows
+static void checkSchedulerRuns(int motorCount) {
+    LoopCost cost = measure(motorCount);
+    TEST_ASSERT_GREATER_THAN(0, cost.cycles);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * cost.cycles + motorCount, (uint32_t)cost.schedulerRuns);
+}
+
+void test_two_motors() {
+    checkSchedulerRuns(2);
+}
+
+void test_eight_motors() {
+    checkSchedulerRuns(8);
+}
+
+void test_thirty_two_motors() {
+    checkSchedulerRuns(32);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_two_motors);
+    RUN_TEST(test_eight_motors);
+    RUN_TEST(test_thirty_two_motors);
+    return UNITY_END();
+}
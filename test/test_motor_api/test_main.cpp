@@ -0,0 +1,72 @@
+// Settings posted to /api/motors/<n> through the firmware's own handlers.
+// A client may send only the fields it changes; the rest keep their values.
+
+#include <unity.h>
+#include "../../src/main.cpp"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Boot the firmware once
+static void boot() {
+    static bool booted = false;
+    if (booted) return;
+    booted = true;
+    sim::reset();
+    sim::setEpoch(1704067200 + 8 * 3600);
+    setup();
+}
+
+// POST `body` to `path` and let loop() apply it
+static void post(const char* path, const char* body) {
+    AsyncWebServerRequest request(HTTP_POST, path);
+    server.handle(request, body);
+    TEST_ASSERT_EQUAL(200, request.responseCode());
+    loop();
+}
+
+// Only rpm changes; tpd, the window, the direction and the drive mode stay
+void test_partial_update_keeps_other_fields() {
+    boot();
+    post("/api/motors/1", "{\"enabled\":true,\"direction\":1,\"tpd\":800,\"windowStart\":600,"
+                          "\"windowEnd\":1000,\"rotationTime\":20,\"restTime\":8,\"rpm\":9,\"driveMode\":1}");
+    post("/api/motors/1", "{\"rpm\":5}");
+
+    MotorSettings s = schedulers[0].getSettings();
+    TEST_ASSERT_EQUAL_INT(5, s.rpm);
+    TEST_ASSERT_TRUE(s.enabled);
+    TEST_ASSERT_EQUAL_INT(DIR_COUNTER_CLOCKWISE, s.direction);
+    TEST_ASSERT_EQUAL_INT(800, s.turnsPerDay);
+    TEST_ASSERT_EQUAL_INT(600, s.windowStart);
+    TEST_ASSERT_EQUAL_INT(1000, s.windowEnd);
+    TEST_ASSERT_EQUAL_INT(20, s.rotationTime);
+    TEST_ASSERT_EQUAL_INT(8, s.restTime);
+    TEST_ASSERT_EQUAL_INT(DRIVE_FULL, s.driveMode);
+
+    // The other motor is untouched
+    TEST_ASSERT_EQUAL_INT(DEFAULT_RPM, schedulers[1].getSettings().rpm);
+}
+
+// Clients that only know about active hours still get a window from the
+// default start, and keep everything else
+void test_active_hours_only() {
+    boot();
+    post("/api/motors/2", "{\"tpd\":700}");
+    post("/api/motors/2", "{\"activeHours\":6}");
+
+    MotorSettings s = schedulers[1].getSettings();
+    TEST_ASSERT_EQUAL_INT(DEFAULT_WINDOW_START, s.windowStart);
+    TEST_ASSERT_EQUAL_INT(windowEndForHours(6), s.windowEnd);
+    TEST_ASSERT_EQUAL_INT(700, s.turnsPerDay);
+    TEST_ASSERT_EQUAL_INT(DEFAULT_RPM, s.rpm);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_partial_update_keeps_other_fields);
+    RUN_TEST(test_active_hours_only);
+    return UNITY_END();
+}
@@ -0,0 +1,101 @@
+// Peak supply current and TPD attainment with 2 to 8 motors started
+// together, with and without the power budget. Built as the shift register
+// chain, so the budget has a slot for each of the eight.
+//
+// Each case winds a two-hour window at the default cadence: the same bursts
+// and rests as a default day, and a sixth of its TPD, in a sixth of the
+// simulated time.
+
+#define COIL_OUTPUT COIL_OUTPUT_SHIFT_REGISTER
+
+#include <unity.h>
+#include <winder_sim.h>
+
+static_assert(MOTOR_COUNT == 8, "The chain build budgets eight motors");
+
+const int WINDOW_MINUTES = 120;
+const int WINDOW_TPD = DEFAULT_TPD * WINDOW_MINUTES / (DEFAULT_ACTIVE_HOURS * 60);
+
+struct WindowReport {
+    uint32_t peakMa;
+    float attainment;           // Worst motor's share of its TPD
+    unsigned long maxWaitMs;
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// All motors drawing `motorMa` each, started together before the window
+// opens and run until well after it closes
+static WindowReport runWindow(int motorCount, bool gated, uint16_t motorMa = MOTOR_CURRENT_MA) {
+    WinderSim sim(motorCount, gated);
+    sim.configureAll(WINDOW_TPD, DEFAULT_WINDOW_START, DEFAULT_WINDOW_START + WINDOW_MINUTES,
+                     DEFAULT_ROTATION_TIME, DEFAULT_REST_TIME, DEFAULT_RPM);
+    for (int m = 0; m < motorCount; m++) {
+        sim.budget.setCurrent(m, motorMa);
+    }
+    sim::setEpoch(simAt(0, 7));
+    sim.startAll();
+    sim.runUntil(simAt(0, 12));
+
+    WindowReport report = {sim.peakMa, 1.0f, sim.budget.getMaxWaitMs()};
+    for (int m = 0; m < motorCount; m++) {
+        float share = (float)sim.stepsToday(m) / (WINDOW_TPD * HALF_STEPS_PER_REVOLUTION);
+        if (share < report.attainment) {
+            report.attainment = share;
+        }
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "%d motors at %u mA, %s: peak %u mA, TPD %.1f%%, longest wait %lu s",
+             motorCount, (unsigned)motorMa, gated ? "budgeted" : "unbudgeted",
+             (unsigned)report.peakMa, report.attainment * 100, report.maxWaitMs / 1000);
+    TEST_MESSAGE(line);
+    return report;
+}
+
+// Within the budget at every motor count, and every motor reaches its TPD
+void test_budget_holds_at_every_motor_count() {
+    const int counts[] = {2, 4, 6, 8};
+    for (int motorCount : counts) {
+        WindowReport report = runWindow(motorCount, true);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(MOTOR_BUDGET_MA, report.peakMa);
+        TEST_ASSERT_EQUAL_FLOAT(1.0f, report.attainment);
+    }
+}
+
+// Without it, eight motors started together all run at once
+void test_unbudgeted_bursts_line_up() {
+    WindowReport report = runWindow(8, false);
+    TEST_ASSERT_EQUAL_UINT32(8 * MOTOR_CURRENT_MA, report.peakMa);
+    TEST_ASSERT_GREATER_THAN_UINT32(MOTOR_BUDGET_MA, report.peakMa);
+}
+
+// Two motors at a time: the eight still fit their whole TPD into the rests
+// between bursts
+void test_tight_budget_still_meets_tpd() {
+    WindowReport report = runWindow(8, true, MOTOR_BUDGET_MA / 2);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MOTOR_BUDGET_MA, report.peakMa);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, report.attainment);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, report.maxWaitMs);
+}
+
+// One motor at a time is more than the rests can absorb: the budget still
+// holds and the shortfall shows in the attainment
+void test_budget_for_one_motor_holds() {
+    WindowReport report = runWindow(8, true, MOTOR_BUDGET_MA);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MOTOR_BUDGET_MA, report.peakMa);
+    TEST_ASSERT_TRUE(report.attainment > 0.5f);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_budget_holds_at_every_motor_count);
+    RUN_TEST(test_unbudgeted_bursts_line_up);
+    RUN_TEST(test_tight_budget_still_meets_tpd);
+    RUN_TEST(test_budget_for_one_motor_holds);
+    return UNITY_END();
+}
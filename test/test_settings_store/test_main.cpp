@@ -0,0 +1,126 @@
+// A/B settings slots on the simulated flash: a power cut at any byte of a
+// write leaves the previous settings loadable, and a burst of changes
+// costs one write.
+
+#include <unity.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "settings_store.h"
+
+const size_t RECORD_BYTES = sizeof(SettingsHeader) + sizeof(SettingsRecord);
+
+void setUp() {
+    sim::reset();
+    sim::fs.clear();
+}
+
+void tearDown() {
+}
+
+// A record told apart by its turns per day
+static SettingsRecord recordWith(int tpd) {
+    SettingsRecord record;
+    memset(&record, 0, sizeof(record));
+    strlcpy(record.ssid, "home", sizeof(record.ssid));
+    record.motorCount = MOTOR_COUNT;
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        record.motors[m].turnsPerDay = tpd;
+    }
+    return record;
+}
+
+// What a fresh boot loads, 0 if nothing
+static int loadedTpd() {
+    SettingsStore store;
+    SettingsRecord record = recordWith(0);
+    return store.load(record) ? record.motors[0].turnsPerDay : 0;
+}
+
+// Cut the power after each possible byte count of the third save, which
+// overwrites the slot holding the first one. The second must survive.
+void test_power_cut_keeps_previous_record() {
+    for (size_t cut = 0; cut < RECORD_BYTES; cut++) {
+        sim::fs.clear();
+        SettingsStore store;
+        TEST_ASSERT_TRUE(store.save(recordWith(600)));
+        TEST_ASSERT_TRUE(store.save(recordWith(700)));
+
+        sim::fs.cutPowerAfter(cut);
+        TEST_ASSERT_FALSE(store.save(recordWith(800)));
+        sim::fs.restorePower();
+
+        TEST_ASSERT_EQUAL(700, loadedTpd());
+    }
+
+    // And a whole write wins
+    sim::fs.clear();
+    SettingsStore store;
+    store.save(recordWith(600));
+    store.save(recordWith(700));
+    sim::fs.cutPowerAfter(RECORD_BYTES);
+    TEST_ASSERT_TRUE(store.save(recordWith(800)));
+    sim::fs.restorePower();
+    TEST_ASSERT_EQUAL(800, loadedTpd());
+}
+
+// A cut before the very first save completes leaves nothing to load, and
+// the defaults stand
+void test_power_cut_on_first_save() {
+    SettingsStore store;
+    sim::fs.cutPowerAfter(sizeof(SettingsHeader) / 2);
+    TEST_ASSERT_FALSE(store.save(recordWith(600)));
+    sim::fs.restorePower();
+    TEST_ASSERT_EQUAL(0, loadedTpd());
+}
+
+// Changes a second apart for 20 s, applied the way loop() does: one record
+// written once they stop. A longer burst is written every
+// SETTINGS_MAX_DELAY_MS. Saving unchanged settings writes nothing.
+void test_burst_of_changes_is_one_write() {
+    SettingsStore store;
+    SettingsRecord record = recordWith(600);
+
+    for (int i = 0; i < 20; i++) {
+        record.motors[0].turnsPerDay = 600 + i;
+        store.markDirty();
+        sim::advanceMs(1000);
+        if (store.isDue()) {
+            store.save(record);
+        }
+    }
+    sim::advanceMs(store.msUntilDue());
+    TEST_ASSERT_TRUE(store.isDue());
+    store.save(record);
+
+    TEST_ASSERT_EQUAL_UINT32(1, store.getWrites());
+    TEST_ASSERT_EQUAL_UINT32(RECORD_BYTES, sim::fs.bytesWritten);
+
+    // Two minutes of changes
+    sim::fs.resetCounters();
+    for (int i = 0; i < 120; i++) {
+        record.motors[0].turnsPerDay = 700 + i;
+        store.markDirty();
+        sim::advanceMs(1000);
+        if (store.isDue()) {
+            store.save(record);
+        }
+    }
+    uint32_t expected = 120000 / SETTINGS_MAX_DELAY_MS;
+    TEST_ASSERT_EQUAL_UINT32(expected * RECORD_BYTES, sim::fs.bytesWritten);
+
+    sim::fs.resetCounters();
+    store.markDirty();
+    sim::advanceMs(SETTINGS_WRITE_DELAY_MS);
+    TEST_ASSERT_TRUE(store.isDue());
+    store.save(record);
+    TEST_ASSERT_EQUAL_UINT32(0, sim::fs.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(1, store.getSkippedWrites());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_power_cut_keeps_previous_record);
+    RUN_TEST(test_power_cut_on_first_save);
+    RUN_TEST(test_burst_of_changes_is_one_write);
+    return UNITY_END();
+}
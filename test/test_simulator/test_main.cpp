@@ -0,0 +1,134 @@
+// A day of winding on virtual time: both motors at default settings,
+// driven the way loop() drives them.
+
+#include <unity.h>
+#include <winder_sim.h>
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Nothing before the window opens, the whole target inside it, and
+// nothing left energized once the day is done
+void test_default_day() {
+    WinderSim sim(MOTOR_COUNT);
+    sim::setEpoch(simAt(0, 0));
+    sim.startAll();
+
+    sim.runUntil(simAt(0, 7, 59));
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        TEST_ASSERT_EQUAL(0, sim.schedulers[m].getCompletedCycles());
+        TEST_ASSERT_FALSE(sim.motors[m].isRunning());
+    }
+
+    sim.runUntil(simAt(0, 20));
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        MotorSettings s = sim.schedulers[m].getSettings();
+        TEST_ASSERT_EQUAL(s.cyclesPerDay, sim.schedulers[m].getCompletedCycles());
+        TEST_ASSERT_EQUAL_UINT32(DEFAULT_TPD * HALF_STEPS_PER_REVOLUTION, sim.stepsToday(m));
+        TEST_ASSERT_EQUAL_UINT32(0, sim.motors[m].getLateSteps());
+    }
+
+    sim.runUntil(simAt(1, 0));
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        MotorSettings s = sim.schedulers[m].getSettings();
+        TEST_ASSERT_EQUAL(s.cyclesPerDay, sim.schedulers[m].getCompletedCycles());
+        TEST_ASSERT_FALSE(sim.motors[m].isRunning());
+        TEST_ASSERT_EQUAL(0, sim.coilsOn(m));
+    }
+}
+
+// A synced day in each drive mode ends on exactly TPD turns, however the
+// daily steps divide into cycles
+static void runDriftDay(DriveMode drive) {
+    WinderSim sim(MOTOR_COUNT);
+    sim::setEpoch(simAt(0, 0));
+    sim.configureAll(DEFAULT_TPD, DEFAULT_WINDOW_START, DEFAULT_WINDOW_END,
+                     DEFAULT_ROTATION_TIME, DEFAULT_REST_TIME, DEFAULT_RPM, drive);
+    sim.startAll();
+    sim.runUntil(simAt(1, 0));
+
+    int cycles = 0;
+    for (int m = 0; m < MOTOR_COUNT; m++) {
+        MotorSettings s = sim.schedulers[m].getSettings();
+        cycles += sim.schedulers[m].getCompletedCycles();
+        TEST_ASSERT_EQUAL(s.cyclesPerDay, sim.schedulers[m].getCompletedCycles());
+        TEST_ASSERT_EQUAL_UINT32(DEFAULT_TPD * HALF_STEPS_PER_REVOLUTION, sim.stepsToday(m));
+        TEST_ASSERT_EQUAL_FLOAT((float)DEFAULT_TPD, sim.schedulers[m].getTotalTurns());
+    }
+    TEST_ASSERT_EQUAL(MOTOR_COUNT * sim.schedulers[0].getSettings().cyclesPerDay, cycles);
+}
+
+void test_no_drift_half_step() {
+    runDriftDay(DRIVE_HALF);
+}
+
+void test_no_drift_full_step() {
+    runDriftDay(DRIVE_FULL);
+}
+
+void test_no_drift_wave() {
+    runDriftDay(DRIVE_WAVE);
+}
+
+// Before SNTP has synced, days are counted from boot and the window is
+// ignored: a day's cycles run straight away, then wait for the next day.
+// A light target keeps the two days quick to simulate.
+void test_unsynced_days_count_from_boot() {
+    WinderSim sim(MOTOR_COUNT);
+    sim.configureAll(60, DEFAULT_WINDOW_START, DEFAULT_WINDOW_END, DEFAULT_ROTATION_TIME,
+                     DEFAULT_REST_TIME, DEFAULT_RPM);
+    sim.startAll();
+
+    sim.runFor(23 * SIM_HOUR_US);
+    int cycles = sim.schedulers[0].getSettings().cyclesPerDay;
+    TEST_ASSERT_EQUAL(cycles, sim.schedulers[0].getCompletedCycles());
+    TEST_ASSERT_EQUAL_UINT32(60 * HALF_STEPS_PER_REVOLUTION, sim.stepsToday(0));
+
+    // The second day starts over at boot + 24 h
+    sim.runFor(SIM_HOUR_US + 1000000);
+    TEST_ASSERT_TRUE(sim.schedulers[0].getCompletedCycles() < cycles);
+    sim.runFor(23 * SIM_HOUR_US);
+    TEST_ASSERT_EQUAL(cycles, sim.schedulers[0].getCompletedCycles());
+}
+
+// Out-of-range settings are clamped to what the record stores, and a zero
+// slot and rest no longer divide by zero: the turns run back to back
+void test_zero_and_negative_settings() {
+    WinderSim sim(1);
+    sim.schedulers[0].setSettings(true, DIR_CLOCKWISE, -50, DEFAULT_WINDOW_START,
+                                  DEFAULT_WINDOW_END, -10, -5, DEFAULT_RPM, DRIVE_HALF);
+    MotorSettings s = sim.schedulers[0].getSettings();
+    TEST_ASSERT_EQUAL(0, s.turnsPerDay);
+    TEST_ASSERT_EQUAL(1, s.rotationTime);
+    TEST_ASSERT_EQUAL(0, s.restTime);
+
+    sim.schedulers[0].setSettings(true, DIR_CLOCKWISE, 70000, DEFAULT_WINDOW_START,
+                                  DEFAULT_WINDOW_END, 70000, 70000, DEFAULT_RPM, DRIVE_HALF);
+    s = sim.schedulers[0].getSettings();
+    TEST_ASSERT_EQUAL(UINT16_MAX, s.turnsPerDay);
+    TEST_ASSERT_EQUAL(UINT16_MAX, s.rotationTime);
+    TEST_ASSERT_EQUAL(UINT16_MAX, s.restTime);
+
+    sim.configureAll(60, DEFAULT_WINDOW_START, DEFAULT_WINDOW_END, 0, 0, DEFAULT_RPM);
+    s = sim.schedulers[0].getSettings();
+    TEST_ASSERT_TRUE(s.cyclesPerDay >= 1);
+    TEST_ASSERT_TRUE(s.cycleDurationMs > 0);
+    sim::setEpoch(simAt(0, 0));
+    sim.startAll();
+    sim.runUntil(simAt(1, 0));
+    TEST_ASSERT_EQUAL_UINT32(60 * HALF_STEPS_PER_REVOLUTION, sim.stepsToday(0));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_default_day);
+    RUN_TEST(test_no_drift_half_step);
+    RUN_TEST(test_no_drift_full_step);
+    RUN_TEST(test_no_drift_wave);
+    RUN_TEST(test_unsynced_days_count_from_boot);
+    RUN_TEST(test_zero_and_negative_settings);
+    return UNITY_END();
+}
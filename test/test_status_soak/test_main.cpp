@@ -0,0 +1,212 @@
+// 100k status requests against the firmware's own handlers, with every heap
+// allocation counted. The body is sent from a static slot and never copied
+// to the heap. What a request does allocate is the response object and its
+// content type, which the async server library creates itself. All of it is
+// freed with the request, and nothing creeps over the soak. A heap that is
+// handed back as it was found cannot fragment.
+
+#include <unity.h>
+#include <cstddef>
+#include <new>
+#include "../../src/main.cpp"
+
+const uint32_t SOAK_REQUESTS = 100000;
+const uint32_t LOOP_EVERY = 50;         // Requests between loop() runs
+
+// The library's response object, its content type and the temporary String
+// the type is passed as. Their size is well below any status body, so a
+// copy of the body can't hide in it.
+const uint32_t RESPONSE_ALLOCATIONS = 3;
+const uint32_t RESPONSE_BYTES = 160;
+
+// Heap record. Each block carries its size in front.
+struct HeapRecord {
+    uint32_t allocations;
+    uint32_t liveBytes;
+    uint32_t peakBytes;
+};
+
+static HeapRecord heapRecord = {0, 0, 0};
+static const size_t HEADER = alignof(std::max_align_t);
+
+static void* countedAlloc(size_t size) {
+    uint8_t* block = (uint8_t*)malloc(size + HEADER);
+    if (!block) throw std::bad_alloc();
+    *(size_t*)block = size;
+    heapRecord.allocations++;
+    heapRecord.liveBytes += size;
+    if (heapRecord.liveBytes > heapRecord.peakBytes) {
+        heapRecord.peakBytes = heapRecord.liveBytes;
+    }
+    sim::freeHeap = 40000 - heapRecord.liveBytes;    // For HeapProbe
+    return block + HEADER;
+}
+
+static void countedFree(void* p) {
+    if (!p) return;
+    uint8_t* block = (uint8_t*)p - HEADER;
+    heapRecord.liveBytes -= *(size_t*)block;
+    sim::freeHeap = 40000 - heapRecord.liveBytes;
+    free(block);
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+// What one request cost the heap
+struct RequestCost {
+    uint32_t allocations;
+    uint32_t peakBytes;         // Above the live bytes before the request
+    uint32_t leftBytes;         // Still live once the request is gone
+};
+
+// A GET handed to `handler`, or routed by the server when there is none.
+// Reading the body back is the test's own allocation and isn't counted;
+// it is copied out to `body` (room for BODY_SIZE) and freed with the request.
+const size_t BODY_SIZE = 4096;
+
+static RequestCost serve(ArRequestHandlerFunction handler, char* body = nullptr) {
+    RequestCost cost;
+    uint32_t allocationsBefore = heapRecord.allocations;
+    uint32_t liveBefore = heapRecord.liveBytes;
+    heapRecord.peakBytes = liveBefore;
+    {
+        AsyncWebServerRequest request(HTTP_GET, "/api/status");
+        if (handler) {
+            handler(&request);
+        } else {
+            server.handle(request);
+        }
+        cost.allocations = heapRecord.allocations - allocationsBefore;
+        cost.peakBytes = heapRecord.peakBytes - liveBefore;
+        TEST_ASSERT_EQUAL(200, request.responseCode());
+        if (body) {
+            strlcpy(body, request.responseBody().c_str(), BODY_SIZE);
+        }
+    }
+    cost.leftBytes = heapRecord.liveBytes - liveBefore;
+    return cost;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Boot the firmware once, winding all day
+static void boot() {
+    static bool booted = false;
+    if (booted) return;
+    booted = true;
+    sim::reset();
+    sim::setEpoch(1704067200 + 8 * 3600);
+    setup();
+    AsyncWebServerRequest start(HTTP_POST, "/api/start");
+    server.handle(start);
+    loop();
+    TEST_ASSERT_TRUE(anyMotorRunning());
+}
+
+static bool anySlotBusy() {
+    for (int i = 0; i < JSON_RESPONSE_SLOTS; i++) {
+        if (jsonSlots[i].busy) return true;
+    }
+    return false;
+}
+
+// One status request allocates the response object and nothing for the body
+void test_status_allocates_only_the_response() {
+    boot();
+    static char body[BODY_SIZE];
+    RequestCost status = serve(handleGetStatus, body);
+    size_t length = strlen(body);
+
+    TEST_ASSERT_TRUE(length > 1);
+    TEST_ASSERT_EQUAL_INT('{', body[0]);
+    TEST_ASSERT_EQUAL_INT('}', body[length - 1]);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RESPONSE_ALLOCATIONS, status.allocations);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RESPONSE_BYTES, status.peakBytes);
+    TEST_ASSERT_EQUAL_UINT32(0, status.leftBytes);
+    TEST_ASSERT_FALSE(anySlotBusy());
+    TEST_ASSERT_EQUAL_UINT32(0, jsonSlotMisses);
+
+    char line[128];
+    snprintf(line, sizeof(line), "status request: %u allocations, %u bytes at peak, %u byte body",
+             (unsigned)status.allocations, (unsigned)status.peakBytes, (unsigned)length);
+    TEST_MESSAGE(line);
+}
+
+// Slow clients keep their slots until they have the whole body. One more
+// request than there are slots gets a heap copy, and a slot is free again
+// as soon as its request is gone.
+void test_slot_held_until_request_is_gone() {
+    boot();
+    AsyncWebServerRequest* held[JSON_RESPONSE_SLOTS];
+    for (int i = 0; i < JSON_RESPONSE_SLOTS; i++) {
+        held[i] = new AsyncWebServerRequest(HTTP_GET, "/api/status");
+        server.handle(*held[i]);
+        TEST_ASSERT_TRUE(jsonSlots[i].busy);
+    }
+
+    static char copied[BODY_SIZE];
+    serve(nullptr, copied);
+    TEST_ASSERT_EQUAL_UINT32(1, jsonSlotMisses);
+    TEST_ASSERT_EQUAL_INT('{', copied[0]);
+
+    for (int i = 0; i < JSON_RESPONSE_SLOTS; i++) {
+        const std::string& body = held[i]->responseBody();
+        TEST_ASSERT_EQUAL_INT('{', body.front());
+        TEST_ASSERT_EQUAL_INT('}', body.back());
+        delete held[i];
+        TEST_ASSERT_FALSE(jsonSlots[i].busy);
+    }
+    jsonSlotMisses = 0;
+}
+
+// 100k requests through the server while the motors wind: none copies its
+// body, and the heap is back where it was after every one
+void test_status_soak() {
+    boot();
+    uint32_t liveAtStart = heapRecord.liveBytes;
+    uint32_t worstAllocations = 0;
+    uint32_t worstPeak = 0;
+
+    for (uint32_t i = 0; i < SOAK_REQUESTS; i++) {
+        if (i % LOOP_EVERY == 0) {
+            sim::advanceMs(1000);
+            loop();
+        }
+        RequestCost cost = serve(nullptr);
+        TEST_ASSERT_EQUAL_UINT32(0, cost.leftBytes);
+        if (cost.allocations > worstAllocations) worstAllocations = cost.allocations;
+        if (cost.peakBytes > worstPeak) worstPeak = cost.peakBytes;
+    }
+
+    // Whatever loop() keeps is its own; requests hold nothing between them
+    RequestHeapStats& stats = requestMetrics.get(REQ_STATUS);
+    TEST_ASSERT_TRUE(stats.count >= SOAK_REQUESTS);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RESPONSE_ALLOCATIONS, worstAllocations);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RESPONSE_BYTES, worstPeak);
+    TEST_ASSERT_EQUAL_UINT32(0, jsonSlotMisses);
+    TEST_ASSERT_FALSE(anySlotBusy());
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%u requests: at most %u allocations and %u bytes each, %d bytes held by loop()",
+             (unsigned)SOAK_REQUESTS, (unsigned)worstAllocations,
+             (unsigned)worstPeak, (int)(heapRecord.liveBytes - liveAtStart));
+    TEST_MESSAGE(line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_status_allocates_only_the_response);
+    RUN_TEST(test_slot_held_until_request_is_gone);
+    RUN_TEST(test_status_soak);
+    return UNITY_END();
+}
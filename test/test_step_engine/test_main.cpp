@@ -0,0 +1,173 @@
+// Step generation independent of loop(): bursts keep their step count and
+// rate whatever the scheduler is doing.
+
+#include <unity.h>
+#include <winder_sim.h>
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+struct BurstResult {
+    uint32_t midSteps;          // Steps 10 s into the first burst
+    uint32_t stepsToday;        // After the first cycle
+    uint32_t lateSteps;
+};
+
+// The first burst at default settings, with loop() stalled for 200 ms out
+// of every second when asked
+static BurstResult firstBurst(bool stalls) {
+    WinderSim sim(1);
+    sim.startAll();
+    BurstResult result;
+    for (int second = 0; second < 60; second++) {
+        if (second == 10) {
+            result.midSteps = sim.motors[0].getStepsCompleted();
+        }
+        if (stalls) {
+            sim.runFor(800000);
+            sim.stall(200000);
+        } else {
+            sim.runFor(1000000);
+        }
+    }
+    TEST_ASSERT_EQUAL(1, sim.schedulers[0].getCompletedCycles());
+    result.stepsToday = sim.stepsToday(0);
+    result.lateSteps = sim.motors[0].getLateSteps();
+    return result;
+}
+
+// A 200 ms gap in scheduler updates, with the engine still ticking,
+// changes neither the step rate nor the burst's step count
+void test_scheduler_gap_keeps_step_count() {
+    BurstResult smooth = firstBurst(false);
+    BurstResult stalled = firstBurst(true);
+
+    TEST_ASSERT_GREATER_THAN(0, smooth.midSteps);
+    TEST_ASSERT_EQUAL_UINT32(smooth.midSteps, stalled.midSteps);
+    TEST_ASSERT_EQUAL_UINT32(smooth.stepsToday, stalled.stepsToday);
+    TEST_ASSERT_EQUAL_UINT32(0, stalled.lateSteps);
+}
+
+// A burst across the micros() wrap (every 71.6 minutes) keeps its rate
+void test_burst_across_micros_wrap() {
+    WinderSim sim(1);
+    sim::reset(0xFFFFFFFFULL - 2000000);
+    StepEngine::begin();
+    sim.motors[0].startSteps(1000, DIR_CLOCKWISE);
+
+    uint64_t start = sim::nowUs;
+    while (sim.motors[0].isRunning()) {
+        sim.runFor(STEP_TICK_US);
+    }
+    TEST_ASSERT_EQUAL(1000, sim.motors[0].getStepsCompleted());
+    TEST_ASSERT_EQUAL_UINT32(0, sim.motors[0].getLateSteps());
+
+    // Cruise interval at 7 RPM, plus a little for the ramp
+    uint64_t cruiseUs = 1000ULL * Stepper::rpmToIntervalUs(DEFAULT_RPM, HALF_STEPS_PER_REVOLUTION);
+    TEST_ASSERT_GREATER_OR_EQUAL(cruiseUs, sim::nowUs - start);
+    TEST_ASSERT_LESS_THAN(cruiseUs + 500000, sim::nowUs - start);
+}
+
+// Every drive mode starts at RAMP_START_US per half-step's worth of shaft
+// travel and ramps over the same stretch of the table: full and wave steps
+// take two entries at a time, each twice as long
+static void checkRamp(DriveMode drive) {
+    WinderSim sim(1);
+    StepTrace trace;
+    TEST_ASSERT_TRUE(trace.begin(256));
+    sim.motors[0].setDriveMode(drive);
+    sim.motors[0].setTrace(&trace);
+    sim.motors[0].startSteps(200, DIR_CLOCKWISE);
+    while (sim.motors[0].isRunning()) {
+        sim.runFor(100000);
+    }
+    sim.motors[0].setTrace(nullptr);
+
+    int stride = drive == DRIVE_HALF ? 1 : 2;
+    unsigned long cruiseUs = Stepper::rpmToIntervalUs(DEFAULT_RPM, sim.motors[0].getStepsPerRevolution());
+    int expectedRamp = 0;
+    for (int i = 0; i < RAMP_STEPS && (unsigned long)RAMP_TABLE.intervalUs[i] * stride > cruiseUs; i += stride) {
+        expectedRamp++;
+    }
+
+    StepEvent events[256];
+    uint16_t count = trace.snapshot(events);
+    TEST_ASSERT_EQUAL(200, count);
+    int ramp = 0;
+    while (ramp < count && events[ramp].getTargetUs() > cruiseUs) {
+        ramp++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, expectedRamp);
+    TEST_ASSERT_EQUAL(expectedRamp, ramp);
+    // Targets are kept in 8 us units
+    TEST_ASSERT_UINT32_WITHIN(8, RAMP_START_US * stride, events[0].getTargetUs());
+    TEST_ASSERT_EQUAL(200, sim.motors[0].getStepsCompleted());
+    TEST_ASSERT_EQUAL_UINT32(0, sim.motors[0].getLateSteps());
+}
+
+void test_ramp_half_step() {
+    checkRamp(DRIVE_HALF);
+}
+
+void test_ramp_full_step() {
+    checkRamp(DRIVE_FULL);
+}
+
+void test_ramp_wave() {
+    checkRamp(DRIVE_WAVE);
+}
+
+// Duty of the coils while cruising at a step interval: full current for
+// the dwell after each step, then HOLD_CHOP_ON of every HOLD_CHOP_PERIOD
+// ticks - but only at HOLD_CHOP_MIN_INTERVAL_US per step or slower
+static float expectedDuty(unsigned long intervalUs) {
+    if (HOLD_DWELL_US == 0 || intervalUs < HOLD_CHOP_MIN_INTERVAL_US) {
+        return 1.0f;
+    }
+    float chopped = (float)(intervalUs - HOLD_DWELL_US) * HOLD_CHOP_ON / HOLD_CHOP_PERIOD;
+    return (HOLD_DWELL_US + chopped) / intervalUs;
+}
+
+// Every supported speed in every drive mode: the motion completes every
+// step, none late, and the coils are on as long as the speed calls for.
+// The coils are off only until the first step.
+void test_hold_chop_only_when_cruising_slowly() {
+    const DriveMode drives[] = {DRIVE_HALF, DRIVE_FULL, DRIVE_WAVE};
+    const int steps = 300;
+    for (DriveMode drive : drives) {
+        for (int rpm = MIN_RPM; rpm <= MAX_RPM; rpm++) {
+            WinderSim sim(1);
+            sim.motors[0].setDriveMode(drive);
+            sim.motors[0].setRpm(rpm);
+            sim.motors[0].startSteps(steps, DIR_CLOCKWISE);
+            while (sim.motors[0].isRunning()) {
+                sim.runFor(1000000);
+            }
+
+            unsigned long intervalUs = Stepper::rpmToIntervalUs(rpm, sim.motors[0].getStepsPerRevolution());
+            float duty = sim.motors[0].getEnergizedDuty();
+            char line[96];
+            snprintf(line, sizeof(line), "%s at %d RPM: %lu us per step, duty %.3f",
+                     DRIVE_MODE_NAMES[drive], rpm, intervalUs, duty);
+            TEST_MESSAGE(line);
+
+            TEST_ASSERT_EQUAL(steps, sim.motors[0].getStepsCompleted());
+            TEST_ASSERT_EQUAL_UINT32(0, sim.motors[0].getLateSteps());
+            TEST_ASSERT_FLOAT_WITHIN(0.02f, expectedDuty(intervalUs), duty);
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduler_gap_keeps_step_count);
+    RUN_TEST(test_burst_across_micros_wrap);
+    RUN_TEST(test_ramp_half_step);
+    RUN_TEST(test_ramp_full_step);
+    RUN_TEST(test_ramp_wave);
+    RUN_TEST(test_hold_chop_only_when_cruising_slowly);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+// Active windows on a simulated clock: entry and exit, windows across
+// midnight, the daily rollover, the millis() wrap every 49.7 days, and day
+// numbers outside UTC.
+
+#include <unity.h>
+#include <winder_sim.h>
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Started late in the window: cycles run until it closes, stop there with
+// the day unfinished, and start over from zero when it opens again
+void test_window_entry_and_exit() {
+    WinderSim sim(1);
+    sim::setEpoch(simAt(0, 19));
+    sim.startAll();
+
+    sim.runUntil(simAt(0, 20));
+    int cycles = sim.schedulers[0].getCompletedCycles();
+    TEST_ASSERT_GREATER_THAN(5, cycles);
+    TEST_ASSERT_LESS_THAN(sim.schedulers[0].getSettings().cyclesPerDay, cycles);
+
+    // Nothing outside the window; a burst under way at 20:00 may finish
+    sim.runUntil(simAt(0, 20, 2));
+    cycles = sim.schedulers[0].getCompletedCycles();
+    sim.runUntil(simAt(1, 7, 59));
+    TEST_ASSERT_EQUAL(cycles, sim.schedulers[0].getCompletedCycles());
+    TEST_ASSERT_FALSE(sim.motors[0].isRunning());
+
+    // The first burst starts as the window opens, on fresh counters
+    sim.runUntil(simAt(1, 8));
+    sim.runFor(1000000);
+    TEST_ASSERT_TRUE(sim.motors[0].isRunning());
+    TEST_ASSERT_EQUAL(0, sim.schedulers[0].getCompletedCycles());
+}
+
+// 22:00-02:00: cycles carry on past midnight without a reset, the day's
+// target is met by 02:00, and the counters reset at 22:00 the next evening
+void test_window_across_midnight() {
+    WinderSim sim(1);
+    sim.configureAll(200, 22 * 60, 2 * 60, DEFAULT_ROTATION_TIME, DEFAULT_REST_TIME,
+                     DEFAULT_RPM);
+    sim::setEpoch(simAt(0, 21));
+    sim.startAll();
+    int planned = sim.schedulers[0].getSettings().cyclesPerDay;
+
+    sim.runUntil(simAt(0, 21, 59));
+    TEST_ASSERT_EQUAL(0, sim.schedulers[0].getCompletedCycles());
+
+    sim.runUntil(simAt(0, 23, 59));
+    int beforeMidnight = sim.schedulers[0].getCompletedCycles();
+    TEST_ASSERT_GREATER_THAN(0, beforeMidnight);
+    sim.runUntil(simAt(1, 0, 30));
+    TEST_ASSERT_GREATER_THAN(beforeMidnight, sim.schedulers[0].getCompletedCycles());
+
+    sim.runUntil(simAt(1, 2));
+    TEST_ASSERT_EQUAL(planned, sim.schedulers[0].getCompletedCycles());
+    TEST_ASSERT_EQUAL_UINT32(200 * HALF_STEPS_PER_REVOLUTION, sim.stepsToday(0));
+
+    sim.runUntil(simAt(1, 21, 59));
+    TEST_ASSERT_EQUAL(planned, sim.schedulers[0].getCompletedCycles());
+    sim.runUntil(simAt(1, 22, 1));
+    TEST_ASSERT_LESS_THAN(planned, sim.schedulers[0].getCompletedCycles());
+}
+
+// An hour of bursts across the millis() wrap keeps its cadence, and the
+// uptime keeps counting
+void test_cycles_across_millis_wrap() {
+    const uint64_t wrapUs = (1ULL << 32) * 1000;
+    WinderSim sim(1);
+    sim::reset(wrapUs - 30 * 60 * 1000000ULL);
+    StepEngine::begin();
+    sim::setEpoch(simAt(0, 12));
+    sim.loopOnce();
+    uint64_t uptimeBefore = sim.wallClock.getUptimeMs();
+    sim.startAll();
+
+    sim.runUntil(simAt(0, 12, 30));
+    int beforeWrap = sim.schedulers[0].getCompletedCycles();
+    sim.runUntil(simAt(0, 13, 30));
+    sim.loopOnce();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3600000, millis());    // Wrapped at 12:30
+
+    // One cycle per burst plus rest, give or take the one under way
+    MotorSettings s = sim.schedulers[0].getSettings();
+    int expected = 3600000 / s.cycleDurationMs;
+    int afterWrap = sim.schedulers[0].getCompletedCycles() - beforeWrap;
+    TEST_ASSERT_INT_WITHIN(1, expected, afterWrap);
+    TEST_ASSERT_EQUAL_UINT32(0, sim.motors[0].getLateSteps());
+
+    TEST_ASSERT_EQUAL_UINT32(5400000, (uint32_t)(sim.wallClock.getUptimeMs() - uptimeBefore));
+}
+
+// Unix times to day numbers, as /api/history's since= is converted: by local
+// date like the clock's own days, not by UTC date
+void test_local_day_in_other_zones() {
+    WinderSim sim(1);
+    const long day = SIM_MIDNIGHT / 86400;
+    struct Zone {
+        const char* tz;
+        int hour;           // UTC, on the second simulated day
+        long expected;      // Local date
+    };
+    const Zone zones[] = {
+        {"EST5", 2, day},           // 21:00 the evening before
+        {"EST5", 6, day + 1},       // 01:00
+        {"JST-9", 14, day + 1},     // 23:00
+        {"JST-9", 16, day + 2},     // 01:00 the morning after
+    };
+    for (const Zone& zone : zones) {
+        setenv("TZ", zone.tz, 1);
+        tzset();
+        sim::setEpoch(simAt(1, zone.hour));
+        TEST_ASSERT_EQUAL_INT(zone.expected, localDay(simAt(1, zone.hour)));
+        TEST_ASSERT_EQUAL_INT(zone.expected, sim.wallClock.read().day);
+    }
+    sim::reset();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_entry_and_exit);
+    RUN_TEST(test_window_across_midnight);
+    RUN_TEST(test_cycles_across_millis_wrap);
+    RUN_TEST(test_local_day_in_other_zones);
+    return UNITY_END();
+}
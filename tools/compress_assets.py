@@ -0,0 +1,66 @@
+# PlatformIO pre-build script: builds the LittleFS image contents.
+#
+# Every file in data/ is gzipped into the filesystem image directory
+# (data_dir in platformio.ini). Content hashes are written to /etags.txt for
+# the firmware's ETag handling, and index.html references style.css and
+# app.js with a ?v=<hash> suffix so those can be cached indefinitely.
+
+Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+
+import gzip
+import hashlib
+import os
+
+SOURCE_DIR = os.path.join(env.subst("$PROJECT_DIR"), "data")  # noqa: F821
+OUTPUT_DIR = env.subst("$PROJECT_DATA_DIR")  # noqa: F821
+
+# Assets whose URLs get a version suffix in index.html
+VERSIONED = ("style.css", "app.js")
+
+
+def content_hash(data):
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def write_gzip(name, data):
+    path = os.path.join(OUTPUT_DIR, name + ".gz")
+    # mtime=0 keeps the output, and so the ETag, reproducible
+    compressed = gzip.compress(data, compresslevel=9, mtime=0)
+    with open(path, "wb") as f:
+        f.write(compressed)
+    return len(compressed)
+
+
+def build():
+    os.makedirs(OUTPUT_DIR, exist_ok=True)
+
+    # Stale files from earlier builds would otherwise end up in the image
+    for name in os.listdir(OUTPUT_DIR):
+        os.remove(os.path.join(OUTPUT_DIR, name))
+
+    sources = {}
+    for name in sorted(os.listdir(SOURCE_DIR)):
+        with open(os.path.join(SOURCE_DIR, name), "rb") as f:
+            sources[name] = f.read()
+
+    hashes = {name: content_hash(data) for name, data in sources.items()}
+
+    if "index.html" in sources:
+        html = sources["index.html"].decode("utf-8")
+        for name in VERSIONED:
+            if name in hashes:
+                html = html.replace('"%s"' % name, '"%s?v=%s"' % (name, hashes[name]))
+        sources["index.html"] = html.encode("utf-8")
+        hashes["index.html"] = content_hash(sources["index.html"])
+
+    etags = []
+    for name, data in sources.items():
+        size = write_gzip(name, data)
+        etags.append("/%s %s\n" % (name, hashes[name]))
+        print("Web asset %s: %d -> %d bytes" % (name, len(data), size))
+
+    with open(os.path.join(OUTPUT_DIR, "etags.txt"), "w") as f:
+        f.writelines(etags)
+
+
+build()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Plot step timing jitter from a /api/diag/steptrace capture.
+#
+# Start a trace, let the motor run a burst, then capture and plot it:
+#
+#   curl -X POST http://watchwinder.local/api/diag/steptrace -d '{"motor": 1}'
+#   curl "http://watchwinder.local/api/diag/steptrace?motor=1" > trace.csv
+#   python3 tools/plot_steptrace.py trace.csv
+#
+# A URL works in place of the file. Prints the same summary the device
+# reports, then shows each step's overshoot past its target interval and a
+# histogram of the overshoots. Needs matplotlib for the plots.
+
+import argparse
+import csv
+import io
+import math
+import sys
+import urllib.request
+
+
+def load(source):
+    if source.startswith("http://") or source.startswith("https://"):
+        with urllib.request.urlopen(source) as response:
+            text = response.read().decode("utf-8")
+    else:
+        with open(source, encoding="utf-8") as f:
+            text = f.read()
+    return [{key: int(value) for key, value in row.items()}
+            for row in csv.DictReader(io.StringIO(text))]
+
+
+def summarize(steps):
+    deltas = [s["deltaUs"] for s in steps]
+    mean = sum(deltas) / len(deltas)
+    variance = sum((d - mean) ** 2 for d in deltas) / len(deltas)
+    missed = sum(1 for s in steps if s["deltaUs"] >= 2 * s["targetUs"])
+    print(f"steps:          {len(steps)}")
+    print(f"mean interval:  {mean:.1f} us")
+    print(f"stddev:         {math.sqrt(variance):.1f} us")
+    print(f"max overshoot:  {max(s['overshootUs'] for s in steps)} us")
+    print(f"missed:         {missed}")
+
+
+def plot(steps, title):
+    import matplotlib.pyplot as plt
+
+    overshoot = [s["overshootUs"] for s in steps]
+    fig, (timeline, histogram) = plt.subplots(2, 1, figsize=(10, 7))
+    fig.suptitle(title)
+
+    timeline.plot(overshoot, linewidth=0.8)
+    timeline.axhline(0, color="grey", linewidth=0.5)
+    timeline.set_xlabel("step")
+    timeline.set_ylabel("overshoot (us)")
+
+    histogram.hist(overshoot, bins=50)
+    histogram.set_xlabel("overshoot (us)")
+    histogram.set_ylabel("steps")
+
+    fig.tight_layout()
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Plot step timing jitter from a trace capture")
+    parser.add_argument("source", help="CSV file or /api/diag/steptrace?motor=n URL")
+    parser.add_argument("--no-plot", action="store_true", help="only print the summary")
+    args = parser.parse_args()
+
+    steps = load(args.source)
+    if not steps:
+        sys.exit("Trace is empty")
+
+    summarize(steps)
+    if not args.no_plot:
+        plot(steps, args.source)
+
+
+if __name__ == "__main__":
+    main()